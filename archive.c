@@ -0,0 +1,283 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * archive.c
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "archive.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "hash.h"
+#include "stats.h"
+
+/* local functions */
+static uint64_t archive_checksum(const uint8_t *map, size_t size);
+
+/* so a changed slide, kernel type or section table is caught like a changed descriptor */
+static uint64_t
+archive_checksum(const uint8_t *map, size_t size)
+{
+    struct archive_header header;
+    memcpy(&header, map, sizeof(header));
+    header.checksum = 0;
+    uint64_t hash = hash64(&header, sizeof(header), ARCHIVE_MAGIC);
+    return hash64(map + sizeof(header), size - sizeof(header), hash);
+}
+
+/*
+ * write the snapshot and everything we know about where it came from
+ * the whole file is built in memory and written with a single write()
+ */
+int
+write_idt_archive(const char *filename, struct config *cfg, const struct idt_snapshot *snapshot, const struct archive_payload *extra, uint32_t nr_extra)
+{
+    if (nr_extra > ARCHIVE_MAX_SECTIONS - 1)
+    {
+        ERROR_MSG("Too many archive sections.");
+        return -1;
+    }
+    size_t idt_size = snapshot->nr_entries * sizeof(struct descriptor_idt);
+    size_t total_size = sizeof(struct archive_header) + idt_size;
+    for (uint32_t i = 0; i < nr_extra; i++)
+    {
+        /* keep every section 8 bytes aligned */
+        total_size += ((size_t)extra[i].entry_size * extra[i].nr_entries + 7) & ~(size_t)7;
+    }
+    uint8_t *buf = calloc(1, total_size);
+    if (buf == NULL)
+    {
+        ERROR_MSG("Can't allocate memory for archive.");
+        return -1;
+    }
+    
+    struct archive_header *header = (struct archive_header*)buf;
+    header->magic = ARCHIVE_MAGIC;
+    header->version = ARCHIVE_VERSION;
+    header->header_size = sizeof(struct archive_header);
+    header->kernel_type = cfg->kernel_type;
+    header->kernel_version = cfg->kernel_version;
+    header->idt_addr = cfg->idt_addr;
+    header->kaslr_slide = cfg->kaslr_slide;
+    header->timestamp = (int64_t)time(NULL);
+    header->idt_size = cfg->idt_size;
+    
+    struct archive_section *section = &header->sections[header->nr_sections++];
+    section->type = ARCHIVE_SECTION_IDT;
+    section->entry_size = sizeof(struct descriptor_idt);
+    section->nr_entries = snapshot->nr_entries;
+    section->offset = sizeof(struct archive_header);
+    section->size = idt_size;
+    memcpy(buf + section->offset, snapshot->descriptors, idt_size);
+    
+    uint64_t offset = section->offset + idt_size;
+    for (uint32_t i = 0; i < nr_extra; i++)
+    {
+        section = &header->sections[header->nr_sections++];
+        section->type = extra[i].type;
+        section->entry_size = extra[i].entry_size;
+        section->nr_entries = extra[i].nr_entries;
+        section->offset = offset;
+        section->size = (uint64_t)extra[i].entry_size * extra[i].nr_entries;
+        memcpy(buf + offset, extra[i].data, section->size);
+        offset += (section->size + 7) & ~7ULL;
+    }
+    
+    header->checksum = archive_checksum(buf, total_size);
+    
+    int ret = -1;
+    int fd = STATS_SYSCALL(open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644));
+    if (fd < 0)
+    {
+        ERROR_MSG("Error while opening file %s, %s.", filename, strerror(errno));
+        free(buf);
+        return -1;
+    }
+    if (STATS_SYSCALL(write(fd, buf, total_size)) == (ssize_t)total_size)
+    {
+        ret = 0;
+    }
+    else
+    {
+        ERROR_MSG("Error while writing archive %s, %s.", filename, strerror(errno));
+    }
+    STATS_SYSCALL(close(fd));
+    free(buf);
+    return ret;
+}
+
+/*
+ * map and validate an archive in one pass
+ * old headerless archives with just the raw descriptors are also accepted
+ * returns 0 on success, -1 if the file can't be used
+ */
+int
+open_idt_archive(const char *filename, struct idt_archive *archive)
+{
+    memset(archive, 0, sizeof(struct idt_archive));
+    
+    int fd = STATS_SYSCALL(open(filename, O_RDONLY));
+    if (fd < 0)
+    {
+        ERROR_MSG("Error while opening file %s, %s.", filename, strerror(errno));
+        return -1;
+    }
+    struct stat stat = {0};
+    if (STATS_SYSCALL(fstat(fd, &stat)) < 0 || stat.st_size == 0)
+    {
+        ERROR_MSG("Can't fstat archive %s or it's empty.", filename);
+        STATS_SYSCALL(close(fd));
+        return -1;
+    }
+    uint8_t *map = STATS_SYSCALL(mmap(0, stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0));
+    STATS_SYSCALL(close(fd));
+    if (map == MAP_FAILED)
+    {
+        ERROR_MSG("mmap of archive %s failed, %s.", filename, strerror(errno));
+        return -1;
+    }
+    archive->map = map;
+    archive->map_size = stat.st_size;
+    
+    const struct archive_header *header = (const struct archive_header*)map;
+    if ((size_t)stat.st_size < sizeof(struct archive_header) || header->magic != ARCHIVE_MAGIC)
+    {
+        if ((size_t)stat.st_size > ARCHIVE_LEGACY_MAX_SIZE || stat.st_size % sizeof(struct descriptor_idt) != 0)
+        {
+            ERROR_MSG("%s is not a valid IDT archive.", filename);
+            close_idt_archive(archive);
+            return -1;
+        }
+        DEBUG_MSG("%s is a legacy archive without header.", filename);
+        archive->legacy = 1;
+        archive->descriptors = (const struct descriptor_idt*)map;
+        archive->nr_entries = (uint32_t)(stat.st_size / sizeof(struct descriptor_idt));
+        archive->kernel_type = X64;
+        return 0;
+    }
+    
+    if (header->version != ARCHIVE_VERSION ||
+        header->header_size != sizeof(struct archive_header) ||
+        header->nr_sections == 0 ||
+        header->nr_sections > ARCHIVE_MAX_SECTIONS)
+    {
+        ERROR_MSG("Unsupported archive %s version %u.", filename, header->version);
+        close_idt_archive(archive);
+        return -1;
+    }
+    for (uint32_t i = 0; i < header->nr_sections; i++)
+    {
+        const struct archive_section *section = &header->sections[i];
+        if (section->offset < sizeof(struct archive_header) ||
+            section->offset > (uint64_t)stat.st_size ||
+            section->size > (uint64_t)stat.st_size - section->offset ||
+            (uint64_t)section->entry_size * section->nr_entries > section->size)
+        {
+            ERROR_MSG("Archive %s section %u is out of bounds.", filename, i);
+            close_idt_archive(archive);
+            return -1;
+        }
+    }
+    const struct archive_section *idt = &header->sections[0];
+    if (idt->type != ARCHIVE_SECTION_IDT ||
+        idt->entry_size != sizeof(struct descriptor_idt) ||
+        idt->nr_entries > IDT_MAX_ENTRIES)
+    {
+        ERROR_MSG("Archive %s has no valid IDT section.", filename);
+        close_idt_archive(archive);
+        return -1;
+    }
+    if (archive_checksum(map, stat.st_size) != header->checksum)
+    {
+        ERROR_MSG("Archive %s checksum mismatch, file is corrupted.", filename);
+        close_idt_archive(archive);
+        return -1;
+    }
+    
+    archive->header = header;
+    archive->descriptors = (const struct descriptor_idt*)(map + idt->offset);
+    archive->nr_entries = idt->nr_entries;
+    archive->kernel_type = header->kernel_type;
+    archive->idt_addr = header->idt_addr;
+    archive->kaslr_slide = header->kaslr_slide;
+    archive->timestamp = header->timestamp;
+    return 0;
+}
+
+/* returns the payload of the first section of type or NULL if the archive doesn't have it */
+const void *
+get_archive_section(const struct idt_archive *archive, uint32_t type, uint32_t *nr_entries)
+{
+    if (archive->header == NULL)
+    {
+        return NULL;
+    }
+    for (uint32_t i = 0; i < archive->header->nr_sections; i++)
+    {
+        const struct archive_section *section = &archive->header->sections[i];
+        if (section->type == type)
+        {
+            if (nr_entries != NULL)
+            {
+                *nr_entries = section->nr_entries;
+            }
+            return archive->map + section->offset;
+        }
+    }
+    return NULL;
+}
+
+void
+close_idt_archive(struct idt_archive *archive)
+{
+    if (archive->map != NULL)
+    {
+        STATS_SYSCALL(munmap(archive->map, archive->map_size));
+    }
+    memset(archive, 0, sizeof(struct idt_archive));
+}
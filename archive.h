@@ -0,0 +1,123 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * archive.h
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef checkidt_archive_h
+#define checkidt_archive_h
+
+#include <stdint.h>
+#include "global.h"
+
+#define ARCHIVE_MAGIC           0x54444943  /* CIDT */
+#define ARCHIVE_VERSION         1
+#define ARCHIVE_MAX_SECTIONS    8
+/* older archives are just the raw descriptors -c -o wrote, one per entry under the IDT limit */
+#define ARCHIVE_LEGACY_MAX_SIZE (IDT_MAX_ENTRIES * sizeof(struct descriptor_idt))
+
+/* section types */
+#define ARCHIVE_SECTION_IDT             1   /* struct descriptor_idt array */
+#define ARCHIVE_SECTION_FINGERPRINTS    2   /* struct stub_fingerprint array */
+#define ARCHIVE_SECTION_SYSENT          3   /* uint64_t sysent handlers, slid */
+#define ARCHIVE_SECTION_MACH_TRAPS      4   /* uint64_t mach_trap_table handlers, slid */
+
+struct archive_section
+{
+    uint32_t type;
+    uint32_t entry_size;
+    uint32_t nr_entries;
+    uint32_t reserved;
+    uint64_t offset;        /* from start of file */
+    uint64_t size;
+};
+
+/*
+ * fixed size header followed by the section payloads
+ * the IDT section is always the first one so readers can use the descriptors in place
+ */
+struct archive_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t nr_sections;
+    int32_t kernel_type;
+    int32_t kernel_version;
+    uint64_t idt_addr;
+    uint64_t kaslr_slide;
+    int64_t timestamp;
+    uint16_t idt_size;
+    uint16_t reserved;
+    uint32_t flags;
+    uint64_t checksum;      /* hash64() of the header with this field zeroed and everything after it */
+    struct archive_section sections[ARCHIVE_MAX_SECTIONS];
+};
+
+/* extra data to store in an archive after the IDT */
+struct archive_payload
+{
+    uint32_t type;
+    uint32_t entry_size;
+    uint32_t nr_entries;
+    const void *data;
+};
+
+/* an archive mapped in memory, header fields are filled with defaults for legacy files */
+struct idt_archive
+{
+    uint8_t *map;
+    size_t map_size;
+    int legacy;
+    const struct archive_header *header;
+    const struct descriptor_idt *descriptors;
+    uint32_t nr_entries;
+    int32_t kernel_type;
+    uint64_t idt_addr;
+    uint64_t kaslr_slide;
+    int64_t timestamp;
+};
+
+int write_idt_archive(const char *filename, struct config *cfg, const struct idt_snapshot *snapshot, const struct archive_payload *extra, uint32_t nr_extra);
+int open_idt_archive(const char *filename, struct idt_archive *archive);
+const void * get_archive_section(const struct idt_archive *archive, uint32_t type, uint32_t *nr_entries);
+void close_idt_archive(struct idt_archive *archive);
+
+#endif
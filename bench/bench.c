@@ -0,0 +1,498 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * bench.c
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/*
+ * benchmarks for the hot paths, runs on Linux against synthetic data only
+ * every stage prints one line of key=value pairs so results can be diffed between builds
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "../global.h"
+#include "../macho.h"
+#include "../kernel.h"
+#include "../idt.h"
+#include "../decode.h"
+#include "../diff.h"
+#include "../archive.h"
+#include "../memsource.h"
+#include "../fleet.h"
+#include "../timer.h"
+#include "../textindex.h"
+
+#define BENCH_IMAGE_BASE    0xffffff8000100000ULL
+#define BENCH_STUBS_OFFSET  0x1000      /* handlers follow the IDT in the image */
+#define BENCH_STUB_SIZE     64
+#define BENCH_TEXT_BASE     0xffffff8000200000ULL
+#define BENCH_BATCH         256         /* operations per timed sample for the cheap stages */
+
+struct bench_options
+{
+    uint32_t nr_symbols;
+    uint32_t iterations;
+    uint32_t nr_archives;
+    uint32_t nr_threads;
+    uint32_t seed;
+};
+
+/* local functions */
+static uint64_t next_random(uint64_t *state);
+static int write_file(const char *path, const void *data, size_t size);
+static int generate_kernel(const char *path, uint32_t nr_symbols, uint64_t *state);
+static int generate_image(const char *path, uint64_t *state);
+static int compare_samples(const void *a, const void *b);
+static void report(const char *stage, uint64_t *samples, uint32_t nr_samples, uint64_t ops_per_sample);
+
+static uint64_t
+next_random(uint64_t *state)
+{
+    /* xorshift64*, good enough and the same everywhere for a given seed */
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+static int
+write_file(const char *path, const void *data, size_t size)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        ERROR_MSG("Can't create %s.", path);
+        return -1;
+    }
+    const uint8_t *p = data;
+    while (size > 0)
+    {
+        ssize_t ret = write(fd, p, size);
+        if (ret <= 0)
+        {
+            close(fd);
+            return -1;
+        }
+        p += ret;
+        size -= ret;
+    }
+    close(fd);
+    return 0;
+}
+
+/*
+ * 64 bits mach-o with __TEXT, __LINKEDIT and LC_SYMTAB, no LC_UUID so the symbol cache stays out of the way
+ * one symbol per IDT handler plus random text symbols, with some debug and undefined
+ * entries mixed in so the filter has work to do
+ */
+static int
+generate_kernel(const char *path, uint32_t nr_symbols, uint64_t *state)
+{
+    uint32_t sizeofcmds = 2 * sizeof(struct segment_command_64) + sizeof(struct symtab_command);
+    uint64_t symoff = 0x1000;
+    uint64_t nlist_size = (uint64_t)nr_symbols * sizeof(struct nlist_64);
+    uint64_t strsize = 1 + (uint64_t)nr_symbols * 16;
+    uint64_t stroff = symoff + nlist_size;
+    size_t file_size = stroff + strsize;
+    
+    uint8_t *buf = calloc(1, file_size);
+    if (buf == NULL)
+    {
+        ERROR_MSG("Can't allocate %zu bytes for the kernel.", file_size);
+        return -1;
+    }
+    struct mach_header_64 *mh = (struct mach_header_64*)buf;
+    mh->magic = MH_MAGIC_64;
+    mh->ncmds = 3;
+    mh->sizeofcmds = sizeofcmds;
+    /* covers the handlers in the image and all the text symbols */
+    struct segment_command_64 *text = (struct segment_command_64*)(mh + 1);
+    text->cmd = LC_SEGMENT_64;
+    text->cmdsize = sizeof(struct segment_command_64);
+    strncpy(text->segname, "__TEXT", sizeof(text->segname));
+    text->vmaddr = BENCH_IMAGE_BASE;
+    text->vmsize = BENCH_TEXT_BASE + (64ULL << 20) - BENCH_IMAGE_BASE;
+    text->initprot = VM_PROT_READ | VM_PROT_EXECUTE;
+    text->maxprot = VM_PROT_READ | VM_PROT_EXECUTE;
+    struct segment_command_64 *seg = text + 1;
+    seg->cmd = LC_SEGMENT_64;
+    seg->cmdsize = sizeof(struct segment_command_64);
+    strncpy(seg->segname, "__LINKEDIT", sizeof(seg->segname));
+    seg->fileoff = symoff;
+    seg->filesize = file_size - symoff;
+    struct symtab_command *symtab = (struct symtab_command*)(seg + 1);
+    symtab->cmd = LC_SYMTAB;
+    symtab->cmdsize = sizeof(struct symtab_command);
+    symtab->symoff = (uint32_t)symoff;
+    symtab->nsyms = nr_symbols;
+    symtab->stroff = (uint32_t)stroff;
+    symtab->strsize = (uint32_t)strsize;
+    
+    struct nlist_64 *nlist = (struct nlist_64*)(buf + symoff);
+    char *strings = (char*)buf + stroff;
+    uint32_t string_off = 1;
+    for (uint32_t i = 0; i < nr_symbols; i++)
+    {
+        uint64_t r = next_random(state);
+        nlist[i].n_un.n_strx = string_off;
+        nlist[i].n_sect = 1;
+        if (i < IDT_MAX_ENTRIES)
+        {
+            nlist[i].n_type = N_SECT | N_EXT;
+            nlist[i].n_value = BENCH_IMAGE_BASE + BENCH_STUBS_OFFSET + i * BENCH_STUB_SIZE;
+        }
+        else
+        {
+            /* roughly what a kernel looks like, mostly defined symbols */
+            uint32_t kind = r % 16;
+            nlist[i].n_type = kind == 0 ? N_STAB : kind == 1 ? (N_UNDF | N_EXT) : (N_SECT | N_EXT);
+            nlist[i].n_value = BENCH_TEXT_BASE + ((r >> 8) % (64ULL << 20));
+        }
+        string_off += snprintf(strings + string_off, 16, "_s%u", i) + 1;
+    }
+    int ret = write_file(path, buf, file_size);
+    free(buf);
+    return ret;
+}
+
+/* IDT at the image base with every handler pointing to random code right after it */
+static int
+generate_image(const char *path, uint64_t *state)
+{
+    size_t image_size = BENCH_STUBS_OFFSET + IDT_MAX_ENTRIES * BENCH_STUB_SIZE;
+    uint8_t *buf = calloc(1, image_size);
+    if (buf == NULL)
+    {
+        return -1;
+    }
+    struct descriptor_idt *idt = (struct descriptor_idt*)buf;
+    for (uint32_t x = 0; x < IDT_MAX_ENTRIES; x++)
+    {
+        uint64_t stub = BENCH_IMAGE_BASE + BENCH_STUBS_OFFSET + x * BENCH_STUB_SIZE;
+        idt[x].offset_low = stub & 0xFFFF;
+        idt[x].offset_middle = (stub >> 16) & 0xFFFF;
+        idt[x].offset_high = (uint32_t)(stub >> 32);
+        idt[x].seg_selector = 0x8;
+        idt[x].flag = 0x8E;
+    }
+    for (size_t i = BENCH_STUBS_OFFSET; i < image_size; i += 8)
+    {
+        uint64_t r = next_random(state);
+        memcpy(buf + i, &r, 8);
+    }
+    int ret = write_file(path, buf, image_size);
+    free(buf);
+    return ret;
+}
+
+static int
+compare_samples(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+/* samples are the time of ops_per_sample operations, latencies are reported per operation */
+static void
+report(const char *stage, uint64_t *samples, uint32_t nr_samples, uint64_t ops_per_sample)
+{
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < nr_samples; i++)
+    {
+        total += samples[i];
+    }
+    qsort(samples, nr_samples, sizeof(uint64_t), compare_samples);
+    double per_op = (double)ops_per_sample;
+    printf("stage=%s samples=%u ops=%llu total_ns=%llu ops_per_sec=%.0f p50_ns=%.1f p90_ns=%.1f p99_ns=%.1f max_ns=%.1f\n",
+           stage, nr_samples, (unsigned long long)(nr_samples * ops_per_sample), (unsigned long long)total,
+           total ? nr_samples * ops_per_sample * 1e9 / total : 0.0,
+           samples[nr_samples / 2] / per_op,
+           samples[(uint64_t)nr_samples * 90 / 100] / per_op,
+           samples[(uint64_t)nr_samples * 99 / 100] / per_op,
+           samples[nr_samples - 1] / per_op);
+    fflush(stdout);
+}
+
+static void
+usage(void)
+{
+    fprintf(stderr, "checkidt_bench [-n symbols] [-i iterations] [-a archives] [-t threads] [-s seed]\n");
+}
+
+int
+main(int argc, char **argv)
+{
+    struct bench_options options = { .nr_symbols = 100000, .iterations = 1000, .nr_archives = 1000, .seed = 1 };
+    int option = 0;
+    while ((option = getopt(argc, argv, "n:i:a:t:s:h")) != -1)
+    {
+        switch (option)
+        {
+            case 'n':
+                options.nr_symbols = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'i':
+                options.iterations = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'a':
+                options.nr_archives = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 't':
+                options.nr_threads = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                options.seed = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+    if (options.nr_symbols < IDT_MAX_ENTRIES || options.iterations == 0 || options.nr_archives == 0)
+    {
+        usage();
+        return 1;
+    }
+    
+    char dir[] = "/tmp/checkidt_bench.XXXXXX";
+    if (mkdtemp(dir) == NULL)
+    {
+        ERROR_MSG("Can't create work directory.");
+        return 1;
+    }
+    uint64_t state = 0x9E3779B97F4A7C15ULL ^ options.seed;
+    struct config cfg = {0};
+    snprintf(cfg.kernel_filename, sizeof(cfg.kernel_filename), "%s/kernel", dir);
+    snprintf(cfg.image_filename, sizeof(cfg.image_filename), "%s/image", dir);
+    snprintf(cfg.out_filename, sizeof(cfg.out_filename), "%s/archive", dir);
+    snprintf(cfg.in_filename, sizeof(cfg.in_filename), "%s/archive", dir);
+    snprintf(cfg.fleet_dir, sizeof(cfg.fleet_dir), "%s/fleet", dir);
+    cfg.kernel_type = X64;
+    cfg.idt_addr = BENCH_IMAGE_BASE;
+    cfg.idt_size = IDT_MAX_ENTRIES * sizeof(struct descriptor_idt) - 1;
+    cfg.idt_entries = IDT_MAX_ENTRIES;
+    cfg.diff_fields = DIFF_FIELD_ALL;
+    cfg.nr_threads = options.nr_threads;
+    /* the machine readable format only prints differences and the bench has none */
+    cfg.output_format = OUTPUT_FORMAT_JSONL;
+    
+    if (generate_kernel(cfg.kernel_filename, options.nr_symbols, &state) != 0 ||
+        generate_image(cfg.image_filename, &state) != 0 ||
+        open_file_source(&cfg.source, cfg.image_filename, BENCH_IMAGE_BASE) != 0)
+    {
+        return 1;
+    }
+    printf("bench=checkidt symbols=%u iterations=%u archives=%u threads=%u seed=%u\n",
+           options.nr_symbols, options.iterations, options.nr_archives, options.nr_threads, options.seed);
+    
+    uint32_t nr_samples = options.iterations;
+    uint64_t *samples = calloc(nr_samples, sizeof(uint64_t));
+    uint32_t nr_loads = MAX(1, nr_samples / 100);
+    
+    /* symbol ingestion, full parse and sort of the kernel file each time */
+    for (uint32_t i = 0; i < nr_loads; i++)
+    {
+        uint64_t start = monotonic_ns();
+        retrieve_kernel_symbols(&cfg);
+        samples[i] = monotonic_ns() - start;
+        if (i + 1 < nr_loads)
+        {
+            release_kernel_symbols(&cfg);
+        }
+    }
+    report("symbols_load", samples, nr_loads, options.nr_symbols);
+    
+    /* symbol lookups at random text addresses */
+    char name[256];
+    for (uint32_t i = 0; i < nr_samples; i++)
+    {
+        uint64_t start = monotonic_ns();
+        for (uint32_t j = 0; j < BENCH_BATCH; j++)
+        {
+            resolve_symbol(&cfg, BENCH_TEXT_BASE + (next_random(&state) % (64ULL << 20)), name, sizeof(name));
+        }
+        samples[i] = monotonic_ns() - start;
+    }
+    report("resolve_symbol", samples, nr_samples, BENCH_BATCH);
+    
+    struct idt_snapshot snapshot = {0};
+    static struct idt_model model;
+    if (read_idt_snapshot(&cfg, &snapshot) != KERN_SUCCESS)
+    {
+        return 1;
+    }
+    for (uint32_t i = 0; i < nr_samples; i++)
+    {
+        uint64_t start = monotonic_ns();
+        for (uint32_t j = 0; j < BENCH_BATCH; j++)
+        {
+            decode_idt(snapshot.descriptors, snapshot.nr_entries, cfg.kernel_type, &model);
+            __asm__ __volatile__("" : : "r"(&model) : "memory");
+        }
+        samples[i] = monotonic_ns() - start;
+    }
+    report("decode_idt", samples, nr_samples, BENCH_BATCH * IDT_MAX_ENTRIES);
+    
+    /* every handler against the kernel text ranges */
+    decode_idt(snapshot.descriptors, snapshot.nr_entries, cfg.kernel_type, &model);
+    uint64_t outside[IDT_MAX_ENTRIES / 64];
+    for (uint32_t i = 0; i < nr_samples; i++)
+    {
+        uint64_t start = monotonic_ns();
+        for (uint32_t j = 0; j < BENCH_BATCH; j++)
+        {
+            text_index_validate(&cfg.text, cfg.kaslr_slide, model.stub, model.nr_entries, outside);
+            __asm__ __volatile__("" : : "r"(outside) : "memory");
+        }
+        samples[i] = monotonic_ns() - start;
+    }
+    report("text_validate", samples, nr_samples, BENCH_BATCH);
+    
+    struct idt_snapshot modified = snapshot;
+    modified.descriptors[next_random(&state) % IDT_MAX_ENTRIES].offset_low ^= 0x10;
+    struct idt_diff diff = {0};
+    for (uint32_t i = 0; i < nr_samples; i++)
+    {
+        uint64_t start = monotonic_ns();
+        for (uint32_t j = 0; j < BENCH_BATCH; j++)
+        {
+            diff_idt_tables(snapshot.descriptors, modified.descriptors, IDT_MAX_ENTRIES, DIFF_FIELD_ALL, &diff);
+            __asm__ __volatile__("" : : "r"(&diff) : "memory");
+        }
+        samples[i] = monotonic_ns() - start;
+    }
+    report("diff_idt", samples, nr_samples, BENCH_BATCH * IDT_MAX_ENTRIES);
+    
+    /* archive round trip, create includes the handler fingerprints */
+    for (uint32_t i = 0; i < nr_samples; i++)
+    {
+        uint64_t start = monotonic_ns();
+        create_idt_archive(&cfg);
+        samples[i] = monotonic_ns() - start;
+    }
+    report("archive_create", samples, nr_samples, 1);
+    
+    for (uint32_t i = 0; i < nr_samples; i++)
+    {
+        struct idt_archive archive = {0};
+        uint64_t start = monotonic_ns();
+        if (open_idt_archive(cfg.in_filename, &archive) == 0)
+        {
+            close_idt_archive(&archive);
+        }
+        samples[i] = monotonic_ns() - start;
+    }
+    report("archive_open", samples, nr_samples, 1);
+    
+    /* live table against the archive, snapshot, decode, diff and fingerprints */
+    for (uint32_t i = 0; i < nr_samples; i++)
+    {
+        uint64_t start = monotonic_ns();
+        compare_idt(&cfg);
+        samples[i] = monotonic_ns() - start;
+    }
+    report("compare_idt", samples, nr_samples, 1);
+    
+    /* a set of archives from different hosts, one of them modified */
+    struct stat st;
+    if (stat(cfg.in_filename, &st) == 0 && mkdir(cfg.fleet_dir, 0755) == 0)
+    {
+        int fd = open(cfg.in_filename, O_RDONLY);
+        uint8_t *archive = malloc(st.st_size);
+        if (fd >= 0 && archive != NULL && read(fd, archive, st.st_size) == st.st_size)
+        {
+            char path[MAXPATHLEN + 16];
+            for (uint32_t i = 0; i < options.nr_archives; i++)
+            {
+                snprintf(path, sizeof(path), "%s/host%u", cfg.fleet_dir, i);
+                write_file(path, archive, st.st_size);
+            }
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        free(archive);
+        
+        /* the report goes to stdout, keep it out of the results */
+        fflush(stdout);
+        int saved_stdout = dup(STDOUT_FILENO);
+        int devnull = open("/dev/null", O_WRONLY);
+        uint32_t nr_fleet = MAX(1, nr_samples / 100);
+        for (uint32_t i = 0; i < nr_fleet; i++)
+        {
+            dup2(devnull, STDOUT_FILENO);
+            uint64_t start = monotonic_ns();
+            analyze_fleet(&cfg);
+            fflush(stdout);
+            samples[i] = monotonic_ns() - start;
+            dup2(saved_stdout, STDOUT_FILENO);
+        }
+        close(devnull);
+        close(saved_stdout);
+        report("fleet_analyze", samples, nr_fleet, (uint64_t)options.nr_archives * IDT_MAX_ENTRIES);
+        
+        for (uint32_t i = 0; i < options.nr_archives; i++)
+        {
+            char path[MAXPATHLEN + 16];
+            snprintf(path, sizeof(path), "%s/host%u", cfg.fleet_dir, i);
+            unlink(path);
+        }
+        rmdir(cfg.fleet_dir);
+    }
+    
+    release_kernel_symbols(&cfg);
+    cfg.source.close(&cfg.source);
+    unlink(cfg.kernel_filename);
+    unlink(cfg.image_filename);
+    unlink(cfg.in_filename);
+    rmdir(dir);
+    free(samples);
+    return 0;
+}
@@ -0,0 +1,321 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * checkidt.c
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "checkidt.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <mach/processor_set.h>
+#include <mach/mach_vm.h>
+#endif
+
+#include "kernel.h"
+#include "idt.h"
+#include "memsource.h"
+#include "stats.h"
+#include "symbols.h"
+#include "kallsyms.h"
+
+/*
+ * defaults for a context, no source is open yet
+ * a context is plain memory, it can live on the stack or inside the caller's own state
+ */
+void
+checkidt_init(struct checkidt_context *ctx)
+{
+    memset(ctx, 0, sizeof(struct checkidt_context));
+    struct config *cfg = &ctx->cfg;
+#ifdef __linux__
+    strncpy(cfg->kernel_filename, LINUX_KALLSYMS_PATH, sizeof(cfg->kernel_filename));
+#else
+    strncpy(cfg->kernel_filename, "/mach_kernel", sizeof(cfg->kernel_filename));
+#endif
+    cfg->diff_fields = DIFF_FIELD_ALL;
+    cfg->source.fd = -1;
+    cfg->interrupt = -1;        /* vector 0 is a valid -a */
+    cfg->history_entry = -1;
+    cfg->history_to = INT64_MAX;
+}
+
+/*
+ * find the running kernel IDT and open a source to read kernel memory
+ * either the kernel task port if available or /dev/kmem, on Linux /proc/kcore
+ */
+int
+checkidt_open_live(struct checkidt_context *ctx)
+{
+#ifdef __APPLE__
+    struct config *cfg = &ctx->cfg;
+    if (getuid() != 0)
+    {
+        ERROR_MSG("This program needs to be run as root!");
+        return -1;
+    }
+    
+    uint64_t phase = stats_begin();
+    cfg->kernel_type = get_kernel_type();
+    if (cfg->kernel_type == -1)
+    {
+        ERROR_MSG("Unable to retrieve kernel type.");
+        return -1;
+    }
+    else if (cfg->kernel_type == X86)
+    {
+        ERROR_MSG("32 bits kernels not supported.");
+        return -1;
+    }
+    
+    cfg->kernel_version = get_kernel_version();
+    cfg->idt_addr = get_addr_idt(cfg->kernel_type);
+    cfg->idt_size = get_size_idt();
+    cfg->idt_entries = (cfg->idt_size + 1) / sizeof(struct descriptor_idt);
+    /* we need to populate the size variable else syscall fails */
+    cfg->kaslr_size = sizeof(cfg->kaslr_size);
+    get_kaslr_slide(&cfg->kaslr_size, &cfg->kaslr_slide);
+    stats_end(STATS_PHASE_KERNEL_INFO, phase);
+    
+    /* test if we can read kernel memory using processor_set_tasks() vulnerability */
+    /* vulnerability presented at BlackHat Asia 2014 by Ming-chieh Pan, Sung-ting Tsai. */
+    /* also described in Mac OS X and iOS Internals, page 387 */
+    host_t host_port = STATS_SYSCALL(mach_host_self());
+    mach_port_t proc_set_default = 0;
+    mach_port_t proc_set_default_control = 0;
+    task_array_t all_tasks = NULL;
+    mach_msg_type_number_t all_tasks_cnt = 0;
+    kern_return_t kr = 0;
+    int valid_kernel_port = 0;
+    
+    phase = stats_begin();
+    kr = STATS_SYSCALL(processor_set_default(host_port, &proc_set_default));
+    if (kr == KERN_SUCCESS)
+    {
+        kr = STATS_SYSCALL(host_processor_set_priv(host_port, proc_set_default, &proc_set_default_control));
+        if (kr == KERN_SUCCESS)
+        {
+            kr = STATS_SYSCALL(processor_set_tasks(proc_set_default_control, &all_tasks, &all_tasks_cnt));
+            if (kr == KERN_SUCCESS)
+            {
+                DEBUG_MSG("Found valid kernel port using processor_set_tasks() vulnerability!");
+                open_mach_source(&cfg->source, all_tasks[0]);
+                valid_kernel_port = 1;
+            }
+        }
+    }
+    /* if we can't use the vulnerability then try /dev/kmem */
+    if (valid_kernel_port == 0)
+    {
+        if (open_kmem_source(&cfg->source, "/dev/kmem") != 0)
+        {
+            ERROR_MSG("Error while opening /dev/kmem. Is /dev/kmem enabled?");
+            ERROR_MSG("Verify that /Library/Preferences/SystemConfiguration/com.apple.Boot.plist has kmem=1 parameter configured.");
+            return -1;
+        }
+    }
+    stats_end(STATS_PHASE_KERNEL_PORT, phase);
+    return 0;
+#elif defined(__linux__)
+    struct config *cfg = &ctx->cfg;
+    if (getuid() != 0)
+    {
+        ERROR_MSG("This program needs to be run as root!");
+        return -1;
+    }
+    /* the symbols give us the text ranges and where the IDT is, the slide is always the live one */
+    if (checkidt_load_symbols(ctx, NULL) != 0)
+    {
+        ERROR_MSG("Unable to load the kernel symbols from %s.", cfg->kernel_filename);
+        return -1;
+    }
+    if (get_linux_kaslr_slide(&cfg->kaslr_slide) != 0)
+    {
+        return -1;
+    }
+    
+    uint64_t phase = stats_begin();
+    cfg->kernel_type = X64;
+    cfg->kernel_version = -1;
+    const struct symbol_entry *idt = symbol_index_find_name(&cfg->symbols, "idt_table");
+    if (idt != NULL)
+    {
+        cfg->idt_addr = idt->address + cfg->kaslr_slide;
+        cfg->idt_size = IDT_MAX_ENTRIES * sizeof(struct descriptor_idt) - 1;
+    }
+    else
+    {
+        /* data symbols are only there with CONFIG_KALLSYMS_ALL, the cpu entry area alias is next best */
+        DEBUG_MSG("No idt_table symbol, using the sidt address.");
+        cfg->idt_addr = get_addr_idt(X64);
+        cfg->idt_size = get_size_idt();
+    }
+    cfg->idt_entries = (cfg->idt_size + 1) / sizeof(struct descriptor_idt);
+    stats_end(STATS_PHASE_KERNEL_INFO, phase);
+    
+    phase = stats_begin();
+    if (open_core_source(&cfg->source, LINUX_KCORE_PATH) != 0)
+    {
+        ERROR_MSG("Error while opening %s. Is CONFIG_PROC_KCORE enabled?", LINUX_KCORE_PATH);
+        return -1;
+    }
+    stats_end(STATS_PHASE_KERNEL_PORT, phase);
+    return 0;
+#else
+    ERROR_MSG("No running OS X kernel here, use -m to analyse a memory image.");
+    return -1;
+#endif
+}
+
+/*
+ * open a kernel memory image for offline analysis
+ * the image is a flat dump of kernel memory starting at image_base
+ */
+int
+checkidt_open_image(struct checkidt_context *ctx, const char *path, mach_vm_address_t base, mach_vm_address_t idt_addr, uint64_t kaslr_slide)
+{
+    struct config *cfg = &ctx->cfg;
+    if (open_file_source(&cfg->source, path, base) != 0)
+    {
+        return -1;
+    }
+    cfg->offline = 1;
+    cfg->image_base = base;
+    cfg->idt_addr = idt_addr;
+    cfg->kaslr_slide = kaslr_slide;
+    if (kaslr_slide == 0 && cfg->source.has_kaslr_offset == 1)
+    {
+        cfg->kaslr_slide = cfg->source.kaslr_offset;
+        DEBUG_MSG("Using the KASLR slide 0x%llx from the core.", (unsigned long long)cfg->kaslr_slide);
+    }
+    /* only 64 bits kernels are supported */
+    cfg->kernel_type = X64;
+    cfg->kernel_version = -1;
+    if (cfg->idt_addr == 0)
+    {
+        cfg->idt_addr = cfg->image_base;
+    }
+    cfg->idt_size = IDT_MAX_ENTRIES * sizeof(struct descriptor_idt) - 1;
+    cfg->idt_entries = IDT_MAX_ENTRIES;
+    return 0;
+}
+
+int
+checkidt_load_symbols(struct checkidt_context *ctx, const char *kernel_path)
+{
+    struct config *cfg = &ctx->cfg;
+    if (kernel_path != NULL)
+    {
+        if (strlen(kernel_path) > sizeof(cfg->kernel_filename) - 1)
+        {
+            ERROR_MSG("File name too long.");
+            return -1;
+        }
+        strncpy(cfg->kernel_filename, kernel_path, sizeof(cfg->kernel_filename));
+    }
+    else if (cfg->symbols.nr_entries > 0)
+    {
+        /* the default file was already loaded, the Linux live open needs it first */
+        return 0;
+    }
+    release_kernel_symbols(cfg);
+    retrieve_kernel_symbols(cfg);
+    if (cfg->symbols.nr_entries == 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+int
+checkidt_read(struct checkidt_context *ctx, void *buffer, mach_vm_address_t address, size_t size)
+{
+    if (ctx->cfg.source.read == NULL)
+    {
+        return -1;
+    }
+    return readkmem(&ctx->cfg, buffer, address, (int)size) == KERN_SUCCESS ? 0 : -1;
+}
+
+int
+checkidt_snapshot(struct checkidt_context *ctx, struct idt_snapshot *snapshot)
+{
+    if (ctx->cfg.source.read == NULL)
+    {
+        return -1;
+    }
+    return read_idt_snapshot(&ctx->cfg, snapshot) == KERN_SUCCESS ? 0 : -1;
+}
+
+void
+checkidt_decode(const struct checkidt_context *ctx, const struct idt_snapshot *snapshot, struct idt_model *model)
+{
+    decode_idt(snapshot->descriptors, snapshot->nr_entries, ctx->cfg.kernel_type, model);
+}
+
+uint32_t
+checkidt_diff(const struct idt_snapshot *a, const struct idt_snapshot *b, uint32_t fields, struct idt_diff *diff)
+{
+    return diff_idt_tables(a->descriptors, b->descriptors, MIN(a->nr_entries, b->nr_entries), fields, diff);
+}
+
+int
+checkidt_resolve(struct checkidt_context *ctx, mach_vm_address_t address, char *name, size_t name_size)
+{
+    return resolve_symbol(&ctx->cfg, address, name, name_size);
+}
+
+/* release everything the context holds, it can be opened again afterwards */
+void
+checkidt_close(struct checkidt_context *ctx)
+{
+    release_kernel_symbols(&ctx->cfg);
+    if (ctx->cfg.source.close != NULL)
+    {
+        ctx->cfg.source.close(&ctx->cfg.source);
+    }
+    ctx->cfg.source.read = NULL;
+    ctx->cfg.source.write = NULL;
+    ctx->cfg.source.map = NULL;
+    ctx->cfg.source.close = NULL;
+}
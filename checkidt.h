@@ -0,0 +1,77 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * checkidt.h
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef checkidt_checkidt_h
+#define checkidt_checkidt_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "global.h"
+#include "decode.h"
+#include "diff.h"
+
+/*
+ * libcheckidt, the checks without the command line tool around them
+ *
+ * a resident process opens a context once and then runs snapshot, decode, diff and
+ * resolve as often as it wants, they only write into buffers supplied by the caller
+ * and never allocate or exit, failures are returned as -1
+ */
+struct checkidt_context
+{
+    struct config cfg;
+};
+
+void checkidt_init(struct checkidt_context *ctx);
+int checkidt_open_live(struct checkidt_context *ctx);
+int checkidt_open_image(struct checkidt_context *ctx, const char *path, mach_vm_address_t base, mach_vm_address_t idt_addr, uint64_t kaslr_slide);
+int checkidt_load_symbols(struct checkidt_context *ctx, const char *kernel_path);
+int checkidt_read(struct checkidt_context *ctx, void *buffer, mach_vm_address_t address, size_t size);
+int checkidt_snapshot(struct checkidt_context *ctx, struct idt_snapshot *snapshot);
+void checkidt_decode(const struct checkidt_context *ctx, const struct idt_snapshot *snapshot, struct idt_model *model);
+uint32_t checkidt_diff(const struct idt_snapshot *a, const struct idt_snapshot *b, uint32_t fields, struct idt_diff *diff);
+int checkidt_resolve(struct checkidt_context *ctx, mach_vm_address_t address, char *name, size_t name_size);
+void checkidt_close(struct checkidt_context *ctx);
+
+#endif
@@ -0,0 +1,220 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * decode.c
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "decode.h"
+
+#include <string.h>
+
+/* local functions */
+static void decode_idt_x86(const struct descriptor_idt *descriptors, uint32_t nr_entries, struct idt_model *model);
+static void decode_idt_x64(const struct descriptor_idt *descriptors, uint32_t nr_entries, struct idt_model *model);
+static void rebase_idt_x86(struct descriptor_idt *descriptors, uint32_t nr_entries, uint64_t delta);
+static void rebase_idt_x64(struct descriptor_idt *descriptors, uint32_t nr_entries, uint64_t delta);
+
+/* gate type names indexed by the type nibble */
+static const char *gate_type_names[16] =
+{
+    "Unknown", "Unknown", "Unknown", "Unknown",
+    "Unknown", "Task gate", "Unknown", "Unknown",
+    "Unknown", "Unknown", "Unknown", "Unknown",
+    /* only interrupt gates are set in OS X... */
+    "Unknown", "Unknown", "Interrupt gate", "Trap gate",
+};
+
+/*
+ * the kernel type is a compile time constant in each specialization below
+ * so the loop has no branches left and the shifts and masks get vectorized
+ */
+static inline __attribute__((always_inline)) void
+decode_idt_generic(const struct descriptor_idt *descriptors, uint32_t nr_entries, struct idt_model *model, const int32_t kernel_type)
+{
+    for (uint32_t x = 0; x < nr_entries; x++)
+    {
+        const struct descriptor_idt *d = &descriptors[x];
+        uint64_t stub = ((uint64_t)d->offset_middle << 16) | d->offset_low;
+        if (kernel_type == X64)
+        {
+            stub |= (uint64_t)d->offset_high << 32;
+        }
+        model->stub[x] = stub;
+        model->selector[x] = d->seg_selector;
+        /* which privilege level can access the interrupt, ring 3 or 0 */
+        model->dpl[x] = (d->flag >> 5) & 0x3;
+        model->type[x] = d->flag & 0xF;
+        model->present[x] = d->flag >> 7;
+        model->ist[x] = d->reserved & 0x7;
+    }
+    model->nr_entries = nr_entries;
+}
+
+static void
+decode_idt_x86(const struct descriptor_idt *descriptors, uint32_t nr_entries, struct idt_model *model)
+{
+    decode_idt_generic(descriptors, nr_entries, model, X86);
+}
+
+static void
+decode_idt_x64(const struct descriptor_idt *descriptors, uint32_t nr_entries, struct idt_model *model)
+{
+    decode_idt_generic(descriptors, nr_entries, model, X64);
+}
+
+/* decode a raw table once, every consumer works from the model */
+void
+decode_idt(const struct descriptor_idt *descriptors, uint32_t nr_entries, int32_t kernel_type, struct idt_model *model)
+{
+    if (nr_entries > IDT_MAX_ENTRIES)
+    {
+        nr_entries = IDT_MAX_ENTRIES;
+    }
+    switch (kernel_type)
+    {
+        case X86:
+            decode_idt_x86(descriptors, nr_entries, model);
+            break;
+        case X64:
+            decode_idt_x64(descriptors, nr_entries, model);
+            break;
+        default:
+            memset(model, 0, sizeof(struct idt_model));
+            break;
+    }
+}
+
+/*
+ * same specialization as the decode, the present and non zero test becomes a mask on the
+ * delta and every descriptor is written back, so the loop has no branches either
+ */
+static inline __attribute__((always_inline)) void
+rebase_idt_generic(struct descriptor_idt *descriptors, uint32_t nr_entries, uint64_t delta, const int32_t kernel_type)
+{
+    for (uint32_t x = 0; x < nr_entries; x++)
+    {
+        struct descriptor_idt *d = &descriptors[x];
+        uint64_t stub = ((uint64_t)d->offset_middle << 16) | d->offset_low;
+        if (kernel_type == X64)
+        {
+            stub |= (uint64_t)d->offset_high << 32;
+        }
+        uint64_t mask = 0 - (uint64_t)((d->flag >> 7) & (stub != 0));
+        stub += delta & mask;
+        d->offset_low = stub & 0xFFFF;
+        d->offset_middle = (stub >> 16) & 0xFFFF;
+        if (kernel_type == X64)
+        {
+            d->offset_high = (uint32_t)(stub >> 32);
+        }
+    }
+}
+
+static void
+rebase_idt_x86(struct descriptor_idt *descriptors, uint32_t nr_entries, uint64_t delta)
+{
+    rebase_idt_generic(descriptors, nr_entries, delta, X86);
+}
+
+static void
+rebase_idt_x64(struct descriptor_idt *descriptors, uint32_t nr_entries, uint64_t delta)
+{
+    rebase_idt_generic(descriptors, nr_entries, delta, X64);
+}
+
+/*
+ * move every present handler of a raw table from one KASLR slide to another
+ * done on the raw descriptors and not on idt_model.stub[], the rebased table is what
+ * the diff engine compares, what fleet hashes and what a restore writes back
+ */
+void
+rebase_idt_descriptors(struct descriptor_idt *descriptors, uint32_t nr_entries, int32_t kernel_type, uint64_t from_slide, uint64_t to_slide)
+{
+    uint64_t delta = to_slide - from_slide;
+    if (delta == 0)
+    {
+        return;
+    }
+    switch (kernel_type)
+    {
+        case X86:
+            rebase_idt_x86(descriptors, nr_entries, delta);
+            break;
+        case X64:
+            rebase_idt_x64(descriptors, nr_entries, delta);
+            break;
+        default:
+            break;
+    }
+}
+
+/* the inverse of the decode for the handler address */
+void
+set_descriptor_stub(struct descriptor_idt *descriptor, uint64_t stub, int32_t kernel_type)
+{
+    descriptor->offset_low = stub & 0xFFFF;
+    descriptor->offset_middle = (stub >> 16) & 0xFFFF;
+    if (kernel_type == X64)
+    {
+        descriptor->offset_high = (uint32_t)(stub >> 32);
+    }
+}
+
+const char *
+get_gate_type_name(uint8_t type)
+{
+    return gate_type_names[type & 0xF];
+}
+
+const char *
+get_segment_name(uint16_t selector)
+{
+    switch (selector)
+    {
+        case KERNEL32_CS:
+            return "KERNEL32_CS";
+        case KERNEL_DS:
+            return "KERNEL_DS";
+        case KERNEL64_CS:
+            return "KERNEL64_CS";
+        default:
+            return "UNKNOWN";
+    }
+}
@@ -0,0 +1,71 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * decode.h
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef checkidt_decode_h
+#define checkidt_decode_h
+
+#include <stdint.h>
+#include "global.h"
+
+/*
+ * decoded IDT, one array per field so consumers only touch what they need
+ * and the decode loop is straight line code the compiler can vectorize
+ */
+struct idt_model
+{
+    uint64_t stub[IDT_MAX_ENTRIES];
+    uint16_t selector[IDT_MAX_ENTRIES];
+    uint8_t dpl[IDT_MAX_ENTRIES];
+    uint8_t type[IDT_MAX_ENTRIES];      /* gate type, low nibble of the flags */
+    uint8_t ist[IDT_MAX_ENTRIES];
+    uint8_t present[IDT_MAX_ENTRIES];
+    uint32_t nr_entries;
+};
+
+void decode_idt(const struct descriptor_idt *descriptors, uint32_t nr_entries, int32_t kernel_type, struct idt_model *model);
+void rebase_idt_descriptors(struct descriptor_idt *descriptors, uint32_t nr_entries, int32_t kernel_type, uint64_t from_slide, uint64_t to_slide);
+void set_descriptor_stub(struct descriptor_idt *descriptor, uint64_t stub, int32_t kernel_type);
+const char * get_gate_type_name(uint8_t type);
+const char * get_segment_name(uint16_t selector);
+
+#endif
@@ -0,0 +1,226 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * diff.c
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "diff.h"
+
+#include <stdio.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/* parse a comma separated list of fields: offset,selector,ist,flags or all */
+int
+parse_diff_fields(const char *list, uint32_t *fields)
+{
+    static const struct
+    {
+        const char *name;
+        uint32_t field;
+    } names[] =
+    {
+        { "offset", DIFF_FIELD_OFFSET },
+        { "selector", DIFF_FIELD_SELECTOR },
+        { "ist", DIFF_FIELD_IST },
+        { "flags", DIFF_FIELD_FLAGS },
+        { "all", DIFF_FIELD_ALL },
+    };
+    
+    *fields = 0;
+    const char *p = list;
+    while (*p != '\0')
+    {
+        size_t len = strcspn(p, ",");
+        int found = 0;
+        for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+        {
+            if (strlen(names[i].name) == len && strncmp(p, names[i].name, len) == 0)
+            {
+                *fields |= names[i].field;
+                found = 1;
+                break;
+            }
+        }
+        if (found == 0)
+        {
+            ERROR_MSG("Unknown descriptor field %.*s.", (int)len, p);
+            return -1;
+        }
+        p += len;
+        if (*p == ',')
+        {
+            p++;
+        }
+    }
+    return *fields != 0 ? 0 : -1;
+}
+
+/* a descriptor with all bits set in the fields we want to compare */
+void
+build_diff_mask(uint32_t fields, struct descriptor_idt *mask)
+{
+    memset(mask, 0, sizeof(struct descriptor_idt));
+    if (fields & DIFF_FIELD_OFFSET)
+    {
+        mask->offset_low = 0xFFFF;
+        mask->offset_middle = 0xFFFF;
+        mask->offset_high = 0xFFFFFFFF;
+    }
+    if (fields & DIFF_FIELD_SELECTOR)
+    {
+        mask->seg_selector = 0xFFFF;
+    }
+    if (fields & DIFF_FIELD_IST)
+    {
+        mask->reserved = 0xFF;
+    }
+    if (fields & DIFF_FIELD_FLAGS)
+    {
+        mask->flag = 0xFF;
+    }
+}
+
+/*
+ * compare two descriptor tables under the field mask and set a bit for every changed entry
+ * the first pass ORs the masked xor of the whole table into one register, so the common
+ * nothing changed case is a few dozen vector instructions and no per entry work at all
+ * returns the number of changed entries
+ */
+uint32_t
+diff_idt_tables(const struct descriptor_idt *a, const struct descriptor_idt *b, uint32_t nr_entries, uint32_t fields, struct idt_diff *diff)
+{
+    struct descriptor_idt mask_desc;
+    build_diff_mask(fields, &mask_desc);
+    memset(diff, 0, sizeof(struct idt_diff));
+    if (nr_entries > IDT_MAX_ENTRIES)
+    {
+        nr_entries = IDT_MAX_ENTRIES;
+    }
+    const uint8_t *pa = (const uint8_t*)a;
+    const uint8_t *pb = (const uint8_t*)b;
+    uint32_t x = 0;
+    
+#if defined(__AVX2__)
+    /* two descriptors per 256 bits lane */
+    __m256i mask = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)&mask_desc));
+    __m256i zero = _mm256_setzero_si256();
+    __m256i acc = zero;
+    for (x = 0; x + 2 <= nr_entries; x += 2)
+    {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(pa + x * 16));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(pb + x * 16));
+        acc = _mm256_or_si256(acc, _mm256_and_si256(_mm256_xor_si256(va, vb), mask));
+    }
+    if (_mm256_testz_si256(acc, acc) == 0)
+    {
+        for (x = 0; x + 2 <= nr_entries; x += 2)
+        {
+            __m256i va = _mm256_loadu_si256((const __m256i*)(pa + x * 16));
+            __m256i vb = _mm256_loadu_si256((const __m256i*)(pb + x * 16));
+            __m256i delta = _mm256_and_si256(_mm256_xor_si256(va, vb), mask);
+            uint32_t equal = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(delta, zero));
+            if ((equal & 0xFFFF) != 0xFFFF)
+            {
+                diff->changed[x / 64] |= 1ULL << (x % 64);
+            }
+            if ((equal >> 16) != 0xFFFF)
+            {
+                diff->changed[(x + 1) / 64] |= 1ULL << ((x + 1) % 64);
+            }
+        }
+    }
+    else
+    {
+        x = nr_entries & ~1U;
+    }
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+    /* one descriptor per 128 bits lane, also handles the odd entry left by AVX2 */
+    __m128i mask128 = _mm_loadu_si128((const __m128i*)&mask_desc);
+    __m128i zero128 = _mm_setzero_si128();
+    __m128i acc128 = zero128;
+    uint32_t start = x;
+    for (; x < nr_entries; x++)
+    {
+        __m128i va = _mm_loadu_si128((const __m128i*)(pa + x * 16));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(pb + x * 16));
+        acc128 = _mm_or_si128(acc128, _mm_and_si128(_mm_xor_si128(va, vb), mask128));
+    }
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc128, zero128)) != 0xFFFF)
+    {
+        for (x = start; x < nr_entries; x++)
+        {
+            __m128i va = _mm_loadu_si128((const __m128i*)(pa + x * 16));
+            __m128i vb = _mm_loadu_si128((const __m128i*)(pb + x * 16));
+            __m128i delta = _mm_and_si128(_mm_xor_si128(va, vb), mask128);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(delta, zero128)) != 0xFFFF)
+            {
+                diff->changed[x / 64] |= 1ULL << (x % 64);
+            }
+        }
+    }
+#else
+    /* portable version, two 64 bits words per descriptor */
+    uint64_t mask64[2];
+    memcpy(mask64, &mask_desc, sizeof(mask64));
+    for (; x < nr_entries; x++)
+    {
+        uint64_t wa[2], wb[2];
+        memcpy(wa, pa + x * 16, sizeof(wa));
+        memcpy(wb, pb + x * 16, sizeof(wb));
+        if ((((wa[0] ^ wb[0]) & mask64[0]) | ((wa[1] ^ wb[1]) & mask64[1])) != 0)
+        {
+            diff->changed[x / 64] |= 1ULL << (x % 64);
+        }
+    }
+#endif
+    
+    for (uint32_t i = 0; i < DIFF_BITMAP_WORDS; i++)
+    {
+        diff->nr_changed += __builtin_popcountll(diff->changed[i]);
+    }
+    return diff->nr_changed;
+}
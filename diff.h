@@ -0,0 +1,76 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * diff.h
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef checkidt_diff_h
+#define checkidt_diff_h
+
+#include <stdint.h>
+#include "global.h"
+
+/* descriptor fields the diff engine can compare */
+#define DIFF_FIELD_OFFSET       0x1     /* handler address */
+#define DIFF_FIELD_SELECTOR     0x2
+#define DIFF_FIELD_IST          0x4     /* interrupt stack table index, the first reserved byte */
+#define DIFF_FIELD_FLAGS        0x8     /* gate type, DPL and present bit */
+#define DIFF_FIELD_ALL          (DIFF_FIELD_OFFSET | DIFF_FIELD_SELECTOR | DIFF_FIELD_IST | DIFF_FIELD_FLAGS)
+
+#define DIFF_BITMAP_WORDS       (IDT_MAX_ENTRIES / 64)
+
+/* bit x set if entry x differs in one of the compared fields */
+struct idt_diff
+{
+    uint64_t changed[DIFF_BITMAP_WORDS];
+    uint32_t nr_changed;
+};
+
+int parse_diff_fields(const char *list, uint32_t *fields);
+void build_diff_mask(uint32_t fields, struct descriptor_idt *mask);
+uint32_t diff_idt_tables(const struct descriptor_idt *a, const struct descriptor_idt *b, uint32_t nr_entries, uint32_t fields, struct idt_diff *diff);
+
+static inline int
+diff_entry_changed(const struct idt_diff *diff, uint32_t entry)
+{
+    return (diff->changed[entry / 64] >> (entry % 64)) & 1;
+}
+
+#endif
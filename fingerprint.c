@@ -0,0 +1,174 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * fingerprint.c
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "fingerprint.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kernel.h"
+#include "hash.h"
+
+/* local functions */
+static int compare_addresses(const void *a, const void *b);
+static int fingerprint_one(struct config *cfg, mach_vm_address_t address, uint64_t *hash);
+
+static int
+compare_addresses(const void *a, const void *b)
+{
+    mach_vm_address_t x = *(const mach_vm_address_t*)a;
+    mach_vm_address_t y = *(const mach_vm_address_t*)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/*
+ * the distinct non null handler addresses of a decoded table, sorted
+ * addresses must have room for nr_entries, returns how many were found
+ */
+uint32_t
+collect_stub_addresses(const uint64_t *stubs, uint32_t nr_entries, mach_vm_address_t *addresses)
+{
+    uint32_t count = 0;
+    for (uint32_t x = 0; x < nr_entries; x++)
+    {
+        if (stubs[x] != 0)
+        {
+            addresses[count++] = stubs[x];
+        }
+    }
+    qsort(addresses, count, sizeof(mach_vm_address_t), compare_addresses);
+    uint32_t unique = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (unique == 0 || addresses[unique - 1] != addresses[i])
+        {
+            addresses[unique++] = addresses[i];
+        }
+    }
+    return unique;
+}
+
+/* a single handler, when the coalesced read of its run failed */
+static int
+fingerprint_one(struct config *cfg, mach_vm_address_t address, uint64_t *hash)
+{
+    uint8_t code[FINGERPRINT_SIZE];
+    const uint8_t *data = mapkmem(cfg, address, FINGERPRINT_SIZE);
+    if (data == NULL && readkmem(cfg, code, address, FINGERPRINT_SIZE) == KERN_SUCCESS)
+    {
+        data = code;
+    }
+    if (data == NULL)
+    {
+        return -1;
+    }
+    *hash = hash64(data, FINGERPRINT_SIZE, 0);
+    return 0;
+}
+
+/*
+ * hash the first FINGERPRINT_SIZE bytes of each handler
+ * addresses must be sorted, handlers are packed close together in the kernel so neighbours
+ * are coalesced into a single readkmem() and the 256 vectors usually cost a couple of reads
+ * sources that can map memory are hashed in place without any copy
+ * if a run can't be read, an unmapped page in a gap for example, its handlers are read one by one
+ * and only the reads that fail there are reported
+ * returns the number of handlers that couldn't be read
+ */
+int
+fingerprint_stubs(struct config *cfg, const mach_vm_address_t *addresses, uint32_t count, struct stub_fingerprint *fingerprints)
+{
+    uint8_t *buf = NULL;     /* only sources that can't map need a copy */
+    int failed = 0;
+    uint32_t i = 0;
+    
+    while (i < count)
+    {
+        /* extend the run while the next handler is close enough and the read stays small */
+        mach_vm_address_t start = addresses[i];
+        mach_vm_address_t end = start + FINGERPRINT_SIZE;
+        uint32_t j = i + 1;
+        while (j < count &&
+               addresses[j] <= end + FINGERPRINT_MAX_GAP &&
+               addresses[j] + FINGERPRINT_SIZE - start <= FINGERPRINT_MAX_READ)
+        {
+            end = addresses[j] + FINGERPRINT_SIZE;
+            j++;
+        }
+        
+        const uint8_t *data = mapkmem(cfg, start, end - start);
+        if (data == NULL && buf == NULL)
+        {
+            /* without it every handler is read on its own below */
+            buf = malloc(FINGERPRINT_MAX_READ);
+        }
+        if (data == NULL && buf != NULL && readkmem_quiet(cfg, buf, start, (int)(end - start)) == KERN_SUCCESS)
+        {
+            data = buf;
+        }
+        for (uint32_t k = i; k < j; k++)
+        {
+            fingerprints[k].address = addresses[k];
+            fingerprints[k].size = FINGERPRINT_SIZE;
+            if (data != NULL)
+            {
+                fingerprints[k].hash = hash64(data + (addresses[k] - start), FINGERPRINT_SIZE, 0);
+                fingerprints[k].valid = 1;
+            }
+            else if (fingerprint_one(cfg, addresses[k], &fingerprints[k].hash) == 0)
+            {
+                fingerprints[k].valid = 1;
+            }
+            else
+            {
+                fingerprints[k].hash = 0;
+                fingerprints[k].valid = 0;
+                failed++;
+            }
+        }
+        i = j;
+    }
+    free(buf);
+    return failed;
+}
@@ -0,0 +1,376 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * fleet.c
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "fleet.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "archive.h"
+#include "decode.h"
+#include "diff.h"
+#include "hash.h"
+#include "stats.h"
+#include "pool.h"
+#include "timer.h"
+
+struct fleet
+{
+    struct fleet_host *hosts;
+    struct descriptor_idt *tables;  /* IDT_MAX_ENTRIES per host */
+    uint32_t nr_hosts;
+    uint32_t *order;                /* host indexes sorted by hash */
+    struct fleet_cluster *clusters;
+};
+
+/* local functions */
+static int collect_archives(const char *dirname, struct fleet *fleet);
+static void load_host(void *context, size_t index, uint32_t worker);
+static int compare_hosts(const void *a, const void *b);
+static void free_fleet(struct fleet *fleet);
+static void report_outlier(struct config *cfg, struct fleet *fleet, const struct fleet_cluster *majority, const struct fleet_cluster *cluster);
+
+static int
+collect_archives(const char *dirname, struct fleet *fleet)
+{
+    DIR *dir = STATS_SYSCALL(opendir(dirname));
+    if (dir == NULL)
+    {
+        ERROR_MSG("Can't open archive directory %s.", dirname);
+        return -1;
+    }
+    uint32_t capacity = 0;
+    struct dirent *dirent = NULL;
+    while ((dirent = STATS_SYSCALL(readdir(dir))) != NULL)
+    {
+        if (dirent->d_name[0] == '.')
+        {
+            continue;
+        }
+        char path[MAXPATHLEN];
+        struct stat st;
+        if (snprintf(path, sizeof(path), "%s/%s", dirname, dirent->d_name) >= (int)sizeof(path) ||
+            stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+        {
+            continue;
+        }
+        if (fleet->nr_hosts == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 1024;
+            struct fleet_host *hosts = realloc(fleet->hosts, capacity * sizeof(struct fleet_host));
+            if (hosts == NULL)
+            {
+                ERROR_MSG("Can't allocate memory for %u archives.", capacity);
+                STATS_SYSCALL(closedir(dir));
+                return -1;
+            }
+            fleet->hosts = hosts;
+        }
+        struct fleet_host *host = &fleet->hosts[fleet->nr_hosts];
+        memset(host, 0, sizeof(struct fleet_host));
+        host->path = strdup(path);
+        if (host->path == NULL)
+        {
+            STATS_SYSCALL(closedir(dir));
+            return -1;
+        }
+        fleet->nr_hosts++;
+    }
+    STATS_SYSCALL(closedir(dir));
+    return 0;
+}
+
+/* pool task, map one archive, copy out its normalized table and hash it */
+static void
+load_host(void *context, size_t index, uint32_t worker)
+{
+    (void)worker;
+    struct fleet *fleet = context;
+    struct fleet_host *host = &fleet->hosts[index];
+    struct descriptor_idt *table = &fleet->tables[index * IDT_MAX_ENTRIES];
+    struct idt_archive archive = {0};
+    
+    if (open_idt_archive(host->path, &archive) != 0)
+    {
+        return;
+    }
+    host->nr_entries = MIN(archive.nr_entries, IDT_MAX_ENTRIES);
+    host->kernel_type = archive.kernel_type;
+    /* closing clears the archive, keep what we still need */
+    uint64_t kaslr_slide = archive.kaslr_slide;
+    host->legacy = archive.legacy;
+    memcpy(table, archive.descriptors, host->nr_entries * sizeof(struct descriptor_idt));
+    close_idt_archive(&archive);
+    
+    /* without the slide hosts running the same kernel produce the same bytes */
+    rebase_idt_descriptors(table, host->nr_entries, host->kernel_type, kaslr_slide, 0);
+    /* the entry count is part of the key, a truncated table is a different table */
+    host->hash = hash64(table, host->nr_entries * sizeof(struct descriptor_idt), host->nr_entries);
+    host->valid = 1;
+}
+
+/* qsort() has no context argument, so it sorts pointers to the hosts instead of indices */
+static int
+compare_hosts(const void *a, const void *b)
+{
+    const struct fleet_host *ha = *(const struct fleet_host * const *)a;
+    const struct fleet_host *hb = *(const struct fleet_host * const *)b;
+    if (ha->hash != hb->hash)
+    {
+        return ha->hash < hb->hash ? -1 : 1;
+    }
+    return strcmp(ha->path, hb->path);
+}
+
+static void
+free_fleet(struct fleet *fleet)
+{
+    for (uint32_t i = 0; i < fleet->nr_hosts; i++)
+    {
+        free(fleet->hosts[i].path);
+    }
+    free(fleet->hosts);
+    free(fleet->tables);
+    free(fleet->order);
+    free(fleet->clusters);
+}
+
+/* all hosts in a cluster share the table, so the diff is done once per cluster */
+static void
+report_outlier(struct config *cfg, struct fleet *fleet, const struct fleet_cluster *majority, const struct fleet_cluster *cluster)
+{
+    struct idt_model reference_model = {0}, outlier_model = {0};
+    const uint32_t *order = fleet->order;
+    uint32_t reference = order[majority->first];
+    uint32_t outlier = order[cluster->first];
+    const struct descriptor_idt *a = &fleet->tables[reference * IDT_MAX_ENTRIES];
+    const struct descriptor_idt *b = &fleet->tables[outlier * IDT_MAX_ENTRIES];
+    uint32_t nr_entries = MIN(fleet->hosts[reference].nr_entries, fleet->hosts[outlier].nr_entries);
+    
+    ERROR_MSG("Cluster 0x%016llx differs from the majority on %u host(s):",
+              (unsigned long long)cluster->hash, cluster->nr_hosts);
+    /* the hosts belong to the report above, keep them on the same stream */
+    for (uint32_t i = 0; i < cluster->nr_hosts && i < FLEET_MAX_LISTED; i++)
+    {
+        ERROR_MSG("        %s", fleet->hosts[order[cluster->first + i]].path);
+    }
+    if (cluster->nr_hosts > FLEET_MAX_LISTED)
+    {
+        ERROR_MSG("        ... and %u more", cluster->nr_hosts - FLEET_MAX_LISTED);
+    }
+    if (fleet->hosts[reference].nr_entries != fleet->hosts[outlier].nr_entries)
+    {
+        ERROR_MSG("IDT has %u entries instead of %u.", fleet->hosts[outlier].nr_entries, fleet->hosts[reference].nr_entries);
+    }
+    
+    struct idt_diff diff = {0};
+    diff_idt_tables(a, b, nr_entries, cfg->diff_fields, &diff);
+    decode_idt(a, nr_entries, fleet->hosts[reference].kernel_type, &reference_model);
+    decode_idt(b, nr_entries, fleet->hosts[outlier].kernel_type, &outlier_model);
+    for (uint32_t x = 0; x < nr_entries; x++)
+    {
+        if (diff_entry_changed(&diff, x) == 0)
+        {
+            continue;
+        }
+        if (outlier_model.stub[x] != reference_model.stub[x])
+        {
+            ERROR_MSG("Interrupt 0x%x: handler 0x%llx instead of 0x%llx (unslid).", x,
+                      (unsigned long long)outlier_model.stub[x], (unsigned long long)reference_model.stub[x]);
+        }
+        if (outlier_model.selector[x] != reference_model.selector[x])
+        {
+            ERROR_MSG("Interrupt 0x%x: selector 0x%x instead of 0x%x.", x, outlier_model.selector[x], reference_model.selector[x]);
+        }
+        if (outlier_model.dpl[x] != reference_model.dpl[x])
+        {
+            ERROR_MSG("Interrupt 0x%x: DPL %u instead of %u.", x, outlier_model.dpl[x], reference_model.dpl[x]);
+        }
+        if (outlier_model.type[x] != reference_model.type[x])
+        {
+            ERROR_MSG("Interrupt 0x%x: %s instead of %s.", x,
+                      get_gate_type_name(outlier_model.type[x]), get_gate_type_name(reference_model.type[x]));
+        }
+        if (outlier_model.present[x] != reference_model.present[x])
+        {
+            ERROR_MSG("Interrupt 0x%x: present bit %u instead of %u.", x, outlier_model.present[x], reference_model.present[x]);
+        }
+        if (outlier_model.ist[x] != reference_model.ist[x])
+        {
+            ERROR_MSG("Interrupt 0x%x: IST %u instead of %u.", x, outlier_model.ist[x], reference_model.ist[x]);
+        }
+    }
+}
+
+/*
+ * offline batch analysis of a directory of archives
+ * archives are loaded, slide normalized and hashed on a work stealing pool
+ * hosts are then grouped by hash and every cluster other than the largest
+ * is diffed entry by entry against it
+ * returns 0 if every host has the same IDT, 1 if not, -1 on errors
+ */
+int
+analyze_fleet(struct config *cfg)
+{
+    struct fleet fleet = {0};
+    
+    if (collect_archives(cfg->fleet_dir, &fleet) != 0)
+    {
+        free_fleet(&fleet);
+        return -1;
+    }
+    if (fleet.nr_hosts == 0)
+    {
+        ERROR_MSG("No archives found in %s.", cfg->fleet_dir);
+        free_fleet(&fleet);
+        return -1;
+    }
+    fleet.tables = malloc((size_t)fleet.nr_hosts * IDT_MAX_ENTRIES * sizeof(struct descriptor_idt));
+    fleet.order = malloc(fleet.nr_hosts * sizeof(uint32_t));
+    fleet.clusters = malloc(fleet.nr_hosts * sizeof(struct fleet_cluster));
+    if (fleet.tables == NULL || fleet.order == NULL || fleet.clusters == NULL)
+    {
+        ERROR_MSG("Can't allocate memory for %u archives.", fleet.nr_hosts);
+        free_fleet(&fleet);
+        return -1;
+    }
+    
+    uint64_t start = monotonic_ns();
+    if (run_pool(fleet.nr_hosts, cfg->nr_threads, load_host, &fleet) != 0)
+    {
+        free_fleet(&fleet);
+        return -1;
+    }
+    uint64_t elapsed = monotonic_ns() - start;
+    
+    /* sort valid hosts by hash so each cluster is one run */
+    uint32_t *order = fleet.order;
+    uint32_t nr_valid = 0;
+    uint64_t nr_descriptors = 0;
+    for (uint32_t i = 0; i < fleet.nr_hosts; i++)
+    {
+        if (fleet.hosts[i].valid)
+        {
+            order[nr_valid++] = i;
+            nr_descriptors += fleet.hosts[i].nr_entries;
+            if (fleet.hosts[i].legacy)
+            {
+                ERROR_MSG("%s is a legacy archive without KASLR slide, it only matches hosts booted with the same slide.", fleet.hosts[i].path);
+            }
+        }
+        else
+        {
+            ERROR_MSG("Skipping %s, not a valid archive.", fleet.hosts[i].path);
+        }
+    }
+    const struct fleet_host **sorted = malloc((nr_valid + 1) * sizeof(struct fleet_host *));
+    if (sorted == NULL)
+    {
+        ERROR_MSG("Can't allocate memory for %u archives.", fleet.nr_hosts);
+        free_fleet(&fleet);
+        return -1;
+    }
+    for (uint32_t i = 0; i < nr_valid; i++)
+    {
+        sorted[i] = &fleet.hosts[order[i]];
+    }
+    qsort(sorted, nr_valid, sizeof(struct fleet_host *), compare_hosts);
+    for (uint32_t i = 0; i < nr_valid; i++)
+    {
+        order[i] = (uint32_t)(sorted[i] - fleet.hosts);
+    }
+    free(sorted);
+    
+    struct fleet_cluster *clusters = fleet.clusters;
+    uint32_t nr_clusters = 0;
+    uint32_t majority = 0;
+    for (uint32_t i = 0; i < nr_valid; i++)
+    {
+        struct fleet_host *host = &fleet.hosts[order[i]];
+        if (nr_clusters == 0 || clusters[nr_clusters - 1].hash != host->hash)
+        {
+            clusters[nr_clusters].hash = host->hash;
+            clusters[nr_clusters].nr_hosts = 0;
+            clusters[nr_clusters].first = i;
+            nr_clusters++;
+        }
+        clusters[nr_clusters - 1].nr_hosts++;
+        host->cluster = nr_clusters - 1;
+        if (clusters[nr_clusters - 1].nr_hosts > clusters[majority].nr_hosts)
+        {
+            majority = nr_clusters - 1;
+        }
+    }
+    
+    INFO_MSG(cfg, "[INFO] Loaded %u of %u archives, %llu descriptors in %.3f ms (%.0f descriptors/s).",
+                  nr_valid, fleet.nr_hosts, (unsigned long long)nr_descriptors, elapsed / 1e6,
+                  elapsed ? nr_descriptors * 1e9 / elapsed : 0.0);
+    if (nr_valid == 0)
+    {
+        free_fleet(&fleet);
+        return -1;
+    }
+    INFO_MSG(cfg, "[INFO] %u distinct IDT(s) after removing the KASLR slide.", nr_clusters);
+    for (uint32_t c = 0; c < nr_clusters; c++)
+    {
+        INFO_MSG(cfg, "[INFO] Cluster 0x%016llx: %u host(s)%s", (unsigned long long)clusters[c].hash,
+                      clusters[c].nr_hosts, c == majority ? " (majority)" : "");
+    }
+    for (uint32_t c = 0; c < nr_clusters; c++)
+    {
+        if (c != majority)
+        {
+            report_outlier(cfg, &fleet, &clusters[majority], &clusters[c]);
+        }
+    }
+    if (nr_clusters == 1)
+    {
+        INFO_MSG(cfg, "[OK] All hosts have the same IDT.");
+    }
+    free_fleet(&fleet);
+    return nr_clusters == 1 ? 0 : 1;
+}
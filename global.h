@@ -45,7 +45,23 @@
 #define checkidt_global_h
 
 #include <sys/param.h>
-#include <sys/queue.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __APPLE__
+#include <mach/mach.h>
+#else
+/*
+ * the offline sources don't need any mach services
+ * so we just need the types to build everything else on other platforms
+ */
+typedef int kern_return_t;
+typedef uint32_t mach_port_t;
+typedef unsigned long long mach_vm_address_t;   /* same as the mach type so %llx works */
+typedef unsigned long long mach_vm_size_t;
+#define KERN_SUCCESS 0
+#define KERN_FAILURE 5
+#endif
 
 #define X86 0
 #define X64 1
@@ -72,17 +88,84 @@
 #define SYSENTER_TF_CS  (USER_CS|0x10000)
 #define SYSENTER_DS     KERNEL64_SS     /* sysenter kernel data segment */
 
-struct symbols
+/*
+ * one entry of the sorted symbol index
+ * the name is an offset into the index string table so entries stay small
+ */
+struct symbol_entry
 {
     uint64_t address;
-    char *name;
-    SLIST_ENTRY(symbols) entries;
+    uint32_t name_off;
+    uint32_t reserved;
+};
+
+/* flat array of symbols sorted by address, built once by retrieve_kernel_symbols() */
+struct symbol_index
+{
+    struct symbol_entry *entries;
+    uint32_t nr_entries;
+    uint32_t capacity;
+    const char *strings;
+    uint32_t strings_size;
+    void *map;          /* set if entries and strings live in a mapped symbol cache */
+                        /* else both share the entries allocation */
+    size_t map_size;
+};
+
+#define TEXT_MAX_RANGES 32
+
+/*
+ * executable ranges of the kernel image, unslid, sorted and merged
+ * start and end are separate arrays so the search only touches the starts
+ */
+struct text_index
+{
+    uint64_t start[TEXT_MAX_RANGES];
+    uint64_t end[TEXT_MAX_RANGES];      /* exclusive */
+    uint32_t nr_ranges;
+};
+
+/* a PT_LOAD segment of an ELF core, kernel addresses [start, end) are at offset in the file */
+struct core_segment
+{
+    uint64_t start;
+    uint64_t end;
+    uint64_t offset;
+};
+
+/*
+ * a source of kernel memory
+ * read is mandatory, write and map are optional and NULL if the backend can't do it
+ * map returns a pointer to size bytes at address without copying or NULL if the range isn't available
+ */
+struct memsource
+{
+    const char *name;
+    kern_return_t (*read)(struct memsource *source, void *buffer, mach_vm_address_t address, size_t size);
+    kern_return_t (*write)(struct memsource *source, const void *buffer, mach_vm_address_t address, size_t size);
+    const void * (*map)(struct memsource *source, mach_vm_address_t address, size_t size);
+    void (*close)(struct memsource *source);
+    /* backend state */
+    int fd;
+    mach_port_t port;
+    uint8_t *image;
+    size_t image_size;
+    mach_vm_address_t base;
+    struct core_segment *segments;  /* sorted by address */
+    uint32_t nr_segments;
+    int has_kaslr_offset;           /* the core's VMCOREINFO note has KERNELOFFSET */
+    uint64_t kaslr_offset;
+    int quiet;                      /* probing reads, the caller reports failures itself */
 };
 
 struct config
 {
     char in_filename[MAXPATHLEN];
     char out_filename[MAXPATHLEN];
+    char kernel_filename[MAXPATHLEN];
+    char image_filename[MAXPATHLEN];
+    mach_vm_address_t image_base;
+    int offline;
     int interrupt;
     int read_file_archive;
     int create_file_archive;
@@ -90,15 +173,37 @@ struct config
     int restore_idt;
     int show_all_descriptors;
     int resolve;
-    int fd_kmem;
+    uint32_t diff_fields;   /* DIFF_FIELD_* to compare */
+    int output_format;      /* OUTPUT_FORMAT_* */
+    int fleet;
+    char fleet_dir[MAXPATHLEN];     /* directory of archives for batch analysis */
+    uint32_t nr_threads;    /* worker threads, 0 for one per cpu */
+    int stats;              /* print timings and counters at exit */
+    int stats_format;
+    int watch;
+    int percpu;
+    double watch_interval;  /* seconds */
     int kernel_type;
+    int kernel_version;
     uint64_t kaslr_slide;
     size_t kaslr_size;
     uint64_t idt_addr;
     uint16_t idt_size;
     uint32_t idt_entries; /* nr of idt entries, should be always 256 */
-    SLIST_HEAD(, symbols) symbols_head;
-    mach_port_t kernel_port;
+    struct symbol_index symbols;
+    struct text_index text;
+    int text_check;         /* validate handlers against the kernel text ranges */
+    int trampolines;        /* follow the handlers code and check where it branches */
+    int syscalls;           /* also check sysent and mach_trap_table */
+    int ignore_slide;       /* compare handlers relative to each side's KASLR slide */
+    int history;
+    char history_filename[MAXPATHLEN];  /* append only IDT history */
+    int history_at_set;
+    int64_t history_at;     /* show the table recorded at this time */
+    int history_entry;      /* show the changes of this entry, -1 for none */
+    int64_t history_from;
+    int64_t history_to;
+    struct memsource source;
 };
 
 /* we only have 16 bytes descriptors because we are running in IA-32e mode! */
@@ -114,10 +219,26 @@ struct descriptor_idt
     uint32_t reserved2;
 } __attribute__((packed));
 
+#define IDT_MAX_ENTRIES 256
+
+/* output formats */
+#define OUTPUT_FORMAT_TABLE     0
+#define OUTPUT_FORMAT_JSONL     1
+#define OUTPUT_FORMAT_BIN       2
+
+/* in memory copy of the whole IDT, read with a single kernel transition */
+struct idt_snapshot
+{
+    struct descriptor_idt descriptors[IDT_MAX_ENTRIES];
+    uint32_t nr_entries;
+};
+
 /* logging macros */
 
 #define ERROR_MSG(fmt, ...) fprintf(stderr, "[ERROR] " fmt " \n", ## __VA_ARGS__)
 #define OUTPUT_MSG(fmt, ...) fprintf(stdout, fmt " \n", ## __VA_ARGS__)
+/* informational lines, kept off stdout when it carries jsonl or bin records */
+#define INFO_MSG(cfg, fmt, ...) fprintf((cfg)->output_format == OUTPUT_FORMAT_TABLE ? stdout : stderr, fmt " \n", ## __VA_ARGS__)
 
 #if DEBUG == 0
 #   define DEBUG_MSG(fmt, ...) do {} while (0)
@@ -0,0 +1,536 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * history.c
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "history.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "idt.h"
+#include "hash.h"
+#include "stats.h"
+#include "decode.h"
+#include "output.h"
+
+/* local functions */
+static int history_map(struct history *history);
+static void history_unmap(struct history *history);
+static const struct history_record * get_record(const struct history *history, uint64_t record);
+static int recover_history(struct history *history);
+static uint32_t count_bits_below(const uint64_t *bitmap, uint32_t bit);
+
+static uint32_t
+count_bits_below(const uint64_t *bitmap, uint32_t bit)
+{
+    uint32_t count = 0;
+    for (uint32_t w = 0; w < bit / 64; w++)
+    {
+        count += __builtin_popcountll(bitmap[w]);
+    }
+    if (bit % 64)
+    {
+        count += __builtin_popcountll(bitmap[bit / 64] & ((1ULL << (bit % 64)) - 1));
+    }
+    return count;
+}
+
+static void
+history_unmap(struct history *history)
+{
+    if (history->data != NULL)
+    {
+        STATS_SYSCALL(munmap(history->data, history->data_size));
+        history->data = NULL;
+    }
+    if (history->index != NULL)
+    {
+        STATS_SYSCALL(munmap((void*)history->index, history->index_map_size));
+        history->index = NULL;
+    }
+}
+
+/* map both files read only, queries only fault in the pages they look at */
+static int
+history_map(struct history *history)
+{
+    struct stat data_stat, index_stat;
+    history_unmap(history);
+    if (STATS_SYSCALL(fstat(history->data_fd, &data_stat)) < 0 || STATS_SYSCALL(fstat(history->index_fd, &index_stat)) < 0)
+    {
+        ERROR_MSG("Can't fstat history, %s.", strerror(errno));
+        return -1;
+    }
+    history->data_size = data_stat.st_size;
+    history->nr_records = index_stat.st_size / sizeof(struct history_index_entry);
+    history->index_map_size = history->nr_records * sizeof(struct history_index_entry);
+    if (history->data_size > 0)
+    {
+        history->data = STATS_SYSCALL(mmap(0, history->data_size, PROT_READ, MAP_SHARED, history->data_fd, 0));
+        if (history->data == MAP_FAILED)
+        {
+            history->data = NULL;
+            ERROR_MSG("mmap of history failed, %s.", strerror(errno));
+            return -1;
+        }
+    }
+    if (history->index_map_size > 0)
+    {
+        void *index = STATS_SYSCALL(mmap(0, history->index_map_size, PROT_READ, MAP_SHARED, history->index_fd, 0));
+        if (index == MAP_FAILED)
+        {
+            ERROR_MSG("mmap of history index failed, %s.", strerror(errno));
+            return -1;
+        }
+        history->index = index;
+    }
+    return 0;
+}
+
+/* bounds checked record header, NULL if the record is damaged */
+static const struct history_record *
+get_record(const struct history *history, uint64_t record)
+{
+    if (record >= history->nr_records)
+    {
+        return NULL;
+    }
+    uint64_t offset = history->index[record].offset;
+    if (offset > history->data_size || history->data_size - offset < sizeof(struct history_record))
+    {
+        return NULL;
+    }
+    const struct history_record *header = (const struct history_record*)(history->data + offset);
+    if (header->magic != HISTORY_RECORD_MAGIC || header->nr_changed > IDT_MAX_ENTRIES ||
+        history->data_size - offset - sizeof(struct history_record) < header->nr_changed * sizeof(struct descriptor_idt))
+    {
+        return NULL;
+    }
+    return header;
+}
+
+/*
+ * a crash can leave a record without its index entry or a partial index entry
+ * drop whatever isn't complete in both files so appends continue from a clean state
+ */
+static int
+recover_history(struct history *history)
+{
+    struct stat index_stat;
+    if (STATS_SYSCALL(fstat(history->index_fd, &index_stat)) < 0)
+    {
+        return -1;
+    }
+    if (index_stat.st_size % sizeof(struct history_index_entry) != 0 &&
+        STATS_SYSCALL(ftruncate(history->index_fd, index_stat.st_size - index_stat.st_size % sizeof(struct history_index_entry))) != 0)
+    {
+        return -1;
+    }
+    if (history_map(history) != 0)
+    {
+        return -1;
+    }
+    uint64_t nr_valid = history->nr_records;
+    while (nr_valid > 0 && get_record(history, nr_valid - 1) == NULL)
+    {
+        nr_valid--;
+    }
+    uint64_t data_end = sizeof(struct history_header);
+    if (nr_valid > 0)
+    {
+        const struct history_record *last = get_record(history, nr_valid - 1);
+        data_end = history->index[nr_valid - 1].offset + sizeof(struct history_record) + last->nr_changed * sizeof(struct descriptor_idt);
+    }
+    if (nr_valid != history->nr_records || data_end != history->data_size)
+    {
+        ERROR_MSG("History was not closed cleanly, dropping %llu incomplete record(s).",
+                  (unsigned long long)(history->nr_records - nr_valid));
+        if (STATS_SYSCALL(ftruncate(history->index_fd, nr_valid * sizeof(struct history_index_entry))) != 0 ||
+            STATS_SYSCALL(ftruncate(history->data_fd, data_end)) != 0)
+        {
+            return -1;
+        }
+        return history_map(history);
+    }
+    return 0;
+}
+
+/*
+ * open or create filename and its index
+ * a writable history also rebuilds the last table so the next append can be a delta
+ */
+int
+history_open(struct history *history, const char *filename, struct config *cfg, int writable)
+{
+    char index_filename[MAXPATHLEN];
+    memset(history, 0, sizeof(struct history));
+    history->data_fd = history->index_fd = -1;
+    if (snprintf(index_filename, sizeof(index_filename), "%s%s", filename, HISTORY_INDEX_SUFFIX) >= (int)sizeof(index_filename))
+    {
+        ERROR_MSG("File name too long.");
+        return -1;
+    }
+    int flags = writable ? (O_RDWR | O_CREAT) : O_RDONLY;
+    history->data_fd = STATS_SYSCALL(open(filename, flags, 0644));
+    history->index_fd = STATS_SYSCALL(open(index_filename, flags, 0644));
+    if (history->data_fd < 0 || history->index_fd < 0)
+    {
+        ERROR_MSG("Can't open history %s, %s.", filename, strerror(errno));
+        history_close(history);
+        return -1;
+    }
+    
+    struct history_header header = {0};
+    ssize_t ret = STATS_SYSCALL(pread(history->data_fd, &header, sizeof(header), 0));
+    if (ret == 0 && writable)
+    {
+        header.magic = HISTORY_MAGIC;
+        header.version = HISTORY_VERSION;
+        header.kernel_type = cfg->kernel_type;
+        header.idt_addr = cfg->idt_addr;
+        header.kaslr_slide = cfg->kaslr_slide;
+        if (STATS_SYSCALL(pwrite(history->data_fd, &header, sizeof(header), 0)) != sizeof(header) || STATS_SYSCALL(ftruncate(history->index_fd, 0)) != 0)
+        {
+            ERROR_MSG("Can't write history header, %s.", strerror(errno));
+            history_close(history);
+            return -1;
+        }
+    }
+    else if (ret != sizeof(header) || header.magic != HISTORY_MAGIC || header.version != HISTORY_VERSION)
+    {
+        ERROR_MSG("%s is not a valid IDT history.", filename);
+        history_close(history);
+        return -1;
+    }
+    if (writable && header.kernel_type != cfg->kernel_type)
+    {
+        ERROR_MSG("History %s was recorded from a different kernel type.", filename);
+        history_close(history);
+        return -1;
+    }
+    history->header = header;
+    history->kaslr_slide = cfg->kaslr_slide;
+    
+    if ((writable ? recover_history(history) : history_map(history)) != 0)
+    {
+        history_close(history);
+        return -1;
+    }
+    if (writable && history->nr_records > 0)
+    {
+        history->last_keyframe = history->index[history->nr_records - 1].keyframe;
+        if (history_read(history, history->nr_records - 1, &history->last) != 0)
+        {
+            history_close(history);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * append a snapshot, a keyframe every HISTORY_KEYFRAME_INTERVAL records or when the
+ * table size changes, else only the descriptors that differ from the previous record
+ * the record is written before its index entry so a crash never indexes a partial record
+ */
+int
+history_append(struct history *history, const struct idt_snapshot *snapshot, int64_t timestamp)
+{
+    struct history_record *record = (struct history_record*)history->record;
+    struct descriptor_idt *descriptors = (struct descriptor_idt*)(record + 1);
+    struct history_index_entry entry = {0};
+    
+    /* every record is kept in the slide of the session that created the file */
+    if (history->kaslr_slide != history->header.kaslr_slide)
+    {
+        history->rebased = *snapshot;
+        rebase_idt_descriptors(history->rebased.descriptors, history->rebased.nr_entries, history->header.kernel_type,
+                               history->kaslr_slide, history->header.kaslr_slide);
+        snapshot = &history->rebased;
+    }
+    memset(record, 0, sizeof(struct history_record));
+    int keyframe = history->nr_records == 0 ||
+                   history->nr_records - history->last_keyframe >= HISTORY_KEYFRAME_INTERVAL ||
+                   snapshot->nr_entries != history->last.nr_entries;
+    for (uint32_t x = 0; x < snapshot->nr_entries; x++)
+    {
+        /* exact compare, the history must give back the bytes we saw */
+        uint64_t changed = history->nr_records == 0 || x >= history->last.nr_entries ||
+                           memcmp(&snapshot->descriptors[x], &history->last.descriptors[x], sizeof(struct descriptor_idt)) != 0;
+        entry.changed[x / 64] |= changed << (x % 64);
+        if (keyframe || changed)
+        {
+            record->changed[x / 64] |= 1ULL << (x % 64);
+            descriptors[record->nr_changed++] = snapshot->descriptors[x];
+        }
+    }
+    record->magic = HISTORY_RECORD_MAGIC;
+    record->type = keyframe ? HISTORY_KEYFRAME : HISTORY_DELTA;
+    record->timestamp = timestamp;
+    record->nr_entries = snapshot->nr_entries;
+    record->checksum = hash64(descriptors, record->nr_changed * sizeof(struct descriptor_idt), 0);
+    
+    size_t record_size = sizeof(struct history_record) + record->nr_changed * sizeof(struct descriptor_idt);
+    struct stat data_stat;
+    if (STATS_SYSCALL(fstat(history->data_fd, &data_stat)) < 0 ||
+        STATS_SYSCALL(pwrite(history->data_fd, record, record_size, data_stat.st_size)) != (ssize_t)record_size)
+    {
+        ERROR_MSG("Can't append to history, %s.", strerror(errno));
+        return -1;
+    }
+    entry.timestamp = timestamp;
+    entry.offset = data_stat.st_size;
+    entry.keyframe = keyframe ? history->nr_records : history->last_keyframe;
+    if (STATS_SYSCALL(pwrite(history->index_fd, &entry, sizeof(entry), history->nr_records * sizeof(entry))) != sizeof(entry))
+    {
+        ERROR_MSG("Can't append to history index, %s.", strerror(errno));
+        return -1;
+    }
+    history->last_keyframe = entry.keyframe;
+    history->last = *snapshot;
+    history->nr_records++;
+    return 0;
+}
+
+/* index of the last record at or before timestamp, -1 if there's none */
+int64_t
+history_find(const struct history *history, int64_t timestamp)
+{
+    const struct history_index_entry *base = history->index;
+    uint64_t n = history->nr_records;
+    if (n == 0 || timestamp < base[0].timestamp)
+    {
+        return -1;
+    }
+    while (n > 1)
+    {
+        uint64_t half = n / 2;
+        base = (base[half].timestamp <= timestamp) ? base + half : base;
+        n -= half;
+    }
+    return base - history->index;
+}
+
+/* the table at a record, its keyframe plus the deltas up to it */
+int
+history_read(const struct history *history, uint64_t record, struct idt_snapshot *snapshot)
+{
+    if (record >= history->nr_records)
+    {
+        return -1;
+    }
+    uint64_t keyframe = history->index[record].keyframe;
+    if (keyframe > record)
+    {
+        ERROR_MSG("History record %llu has an invalid keyframe.", (unsigned long long)record);
+        return -1;
+    }
+    memset(snapshot, 0, sizeof(struct idt_snapshot));
+    for (uint64_t r = keyframe; r <= record; r++)
+    {
+        const struct history_record *header = get_record(history, r);
+        if (header == NULL || header->nr_entries > IDT_MAX_ENTRIES || (r == keyframe && header->type != HISTORY_KEYFRAME))
+        {
+            ERROR_MSG("History record %llu is damaged.", (unsigned long long)r);
+            return -1;
+        }
+        const struct descriptor_idt *descriptors = (const struct descriptor_idt*)(header + 1);
+        if (hash64(descriptors, header->nr_changed * sizeof(struct descriptor_idt), 0) != header->checksum)
+        {
+            ERROR_MSG("History record %llu checksum mismatch.", (unsigned long long)r);
+            return -1;
+        }
+        uint32_t d = 0;
+        for (uint32_t x = 0; x < header->nr_entries && d < header->nr_changed; x++)
+        {
+            if ((header->changed[x / 64] >> (x % 64)) & 1)
+            {
+                snapshot->descriptors[x] = descriptors[d++];
+            }
+        }
+        snapshot->nr_entries = header->nr_entries;
+    }
+    return 0;
+}
+
+/* the new descriptor of entry at record if it changed there, only that record's pages are touched */
+const struct descriptor_idt *
+history_entry_descriptor(const struct history *history, uint64_t record, uint32_t entry)
+{
+    const struct history_record *header = get_record(history, record);
+    if (header == NULL || entry >= header->nr_entries || ((header->changed[entry / 64] >> (entry % 64)) & 1) == 0)
+    {
+        return NULL;
+    }
+    return (const struct descriptor_idt*)(header + 1) + count_bits_below(header->changed, entry);
+}
+
+void
+history_close(struct history *history)
+{
+    history_unmap(history);
+    if (history->data_fd >= 0)
+    {
+        STATS_SYSCALL(close(history->data_fd));
+    }
+    if (history->index_fd >= 0)
+    {
+        STATS_SYSCALL(close(history->index_fd));
+    }
+    history->data_fd = history->index_fd = -1;
+}
+
+/* -c with --history, append the current table */
+int
+append_idt_history(struct config *cfg)
+{
+    struct history history;
+    struct idt_snapshot snapshot = {0};
+    if (read_idt_snapshot(cfg, &snapshot) != KERN_SUCCESS)
+    {
+        return -1;
+    }
+    if (history_open(&history, cfg->history_filename, cfg, 1) != 0)
+    {
+        return -1;
+    }
+    int ret = history_append(&history, &snapshot, (int64_t)time(NULL));
+    history_close(&history);
+    if (ret == 0 && cfg->output_format == OUTPUT_FORMAT_TABLE)
+    {
+        OUTPUT_MSG("[OK] Appended IDT to history %s.", cfg->history_filename);
+    }
+    return ret;
+}
+
+/*
+ * history queries, the table at a time (--at), the changes of one entry in a
+ * time range (--entry with --from/--to) or a summary
+ */
+int
+show_idt_history(struct config *cfg)
+{
+    struct history history;
+    struct idt_snapshot snapshot = {0};
+    struct idt_model model = {0};
+    
+    if (history_open(&history, cfg->history_filename, cfg, 0) != 0)
+    {
+        return -1;
+    }
+    if (cfg->history_entry >= 0)
+    {
+        /* first record inside the range, then walk the index until we are past it */
+        int64_t first = history_find(&history, cfg->history_from - 1) + 1;
+        uint32_t entry = (uint32_t)cfg->history_entry;
+        for (uint64_t r = first; r < history.nr_records && history.index[r].timestamp <= cfg->history_to; r++)
+        {
+            if (((history.index[r].changed[entry / 64] >> (entry % 64)) & 1) == 0)
+            {
+                continue;
+            }
+            const struct descriptor_idt *descriptor = history_entry_descriptor(&history, r, entry);
+            if (descriptor == NULL)
+            {
+                ERROR_MSG("History record %llu is damaged.", (unsigned long long)r);
+                continue;
+            }
+            decode_idt(descriptor, 1, history.header.kernel_type, &model);
+            if (cfg->output_format == OUTPUT_FORMAT_TABLE)
+            {
+                OUTPUT_MSG("%lld interrupt 0x%x: stub 0x%llx selector %s DPL %u %s%s", (long long)history.index[r].timestamp,
+                           entry, (unsigned long long)model.stub[0], get_segment_name(model.selector[0]), model.dpl[0],
+                           get_gate_type_name(model.type[0]), model.present[0] ? "" : " (not present)");
+                continue;
+            }
+            struct output_entry record = {0};
+            record.interrupt = entry;
+            record.stub = model.stub[0];
+            record.selector = model.selector[0];
+            record.dpl = model.dpl[0];
+            record.type = model.type[0];
+            record.ist = model.ist[0];
+            record.present = model.present[0];
+            record.timestamp = history.index[r].timestamp;
+            output_entry(&record);
+        }
+        output_flush();
+    }
+    else if (cfg->history_at_set == 1)
+    {
+        int64_t record = history_find(&history, cfg->history_at);
+        if (record < 0 || history_read(&history, record, &snapshot) != 0)
+        {
+            ERROR_MSG("No IDT in the history at %lld.", (long long)cfg->history_at);
+            history_close(&history);
+            return -1;
+        }
+        if (cfg->output_format == OUTPUT_FORMAT_TABLE)
+        {
+            OUTPUT_MSG("[INFO] IDT recorded at %lld", (long long)history.index[record].timestamp);
+        }
+        decode_idt(snapshot.descriptors, snapshot.nr_entries, history.header.kernel_type, &model);
+        print_idt_table(cfg, &model);
+    }
+    else if (history.nr_records > 0)
+    {
+        uint64_t nr_keyframes = 0;
+        for (uint64_t r = 0; r < history.nr_records; r++)
+        {
+            nr_keyframes += history.index[r].keyframe == r;
+        }
+        INFO_MSG(cfg, "[INFO] %llu records (%llu keyframes) from %lld to %lld, %zu bytes.",
+                      (unsigned long long)history.nr_records, (unsigned long long)nr_keyframes,
+                      (long long)history.index[0].timestamp, (long long)history.index[history.nr_records - 1].timestamp,
+                      history.data_size + history.index_map_size);
+    }
+    history_close(&history);
+    return 0;
+}
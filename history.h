@@ -0,0 +1,129 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * history.h
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef checkidt_history_h
+#define checkidt_history_h
+
+#include <stdint.h>
+#include "global.h"
+#include "diff.h"
+
+#define HISTORY_MAGIC               0x54534849  /* IHST */
+#define HISTORY_RECORD_MAGIC        0x43455248  /* HREC */
+#define HISTORY_VERSION             1
+#define HISTORY_KEYFRAME_INTERVAL   256         /* a full table at least every this many records */
+#define HISTORY_INDEX_SUFFIX        ".idx"
+
+/* record types */
+#define HISTORY_KEYFRAME            1   /* all descriptors */
+#define HISTORY_DELTA               2   /* descriptors changed since the previous record */
+
+struct history_header
+{
+    uint32_t magic;
+    uint32_t version;
+    int32_t kernel_type;
+    uint32_t reserved;
+    uint64_t idt_addr;
+    uint64_t kaslr_slide;       /* of the first session, later appends are rebased to it */
+};
+
+/*
+ * in the data file, followed by one descriptor per bit set in changed, in entry order
+ * keyframes have every entry of the table set
+ */
+struct history_record
+{
+    uint32_t magic;
+    uint16_t type;
+    uint16_t nr_changed;
+    int64_t timestamp;
+    uint64_t changed[DIFF_BITMAP_WORDS];
+    uint32_t nr_entries;    /* entries of the table at this point */
+    uint32_t reserved;
+    uint64_t checksum;      /* hash64() of the descriptors */
+};
+
+/*
+ * index file, one fixed size entry per record in time order
+ * seeks by timestamp are a binary search here, the changed bitmap answers
+ * "when did entry x change" without touching the data file
+ */
+struct history_index_entry
+{
+    int64_t timestamp;
+    uint64_t offset;            /* of the record in the data file */
+    uint64_t keyframe;          /* index of the keyframe this record builds on */
+    uint64_t changed[DIFF_BITMAP_WORDS];
+};
+
+struct history
+{
+    int data_fd;
+    int index_fd;
+    struct history_header header;
+    uint8_t *data;              /* read only mappings, refreshed by history_map() */
+    size_t data_size;
+    const struct history_index_entry *index;
+    uint64_t nr_records;
+    size_t index_map_size;
+    uint64_t last_keyframe;
+    struct idt_snapshot last;   /* table of the last record, deltas are against it */
+    uint64_t kaslr_slide;       /* of this session, appends are rebased from it to the header's */
+    struct idt_snapshot rebased;
+    /* history_append() builds each record here, the header then its descriptors */
+    uint64_t record[(sizeof(struct history_record) + IDT_MAX_ENTRIES * sizeof(struct descriptor_idt) + 7) / 8];
+};
+
+int history_open(struct history *history, const char *filename, struct config *cfg, int writable);
+int history_append(struct history *history, const struct idt_snapshot *snapshot, int64_t timestamp);
+int64_t history_find(const struct history *history, int64_t timestamp);
+int history_read(const struct history *history, uint64_t record, struct idt_snapshot *snapshot);
+const struct descriptor_idt * history_entry_descriptor(const struct history *history, uint64_t record, uint32_t entry);
+void history_close(struct history *history);
+
+int append_idt_history(struct config *cfg);
+int show_idt_history(struct config *cfg);
+
+#endif
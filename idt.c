@@ -51,13 +51,34 @@
 #include <string.h>
 #include <sys/types.h>
 #include <stdint.h>
-#include <sys/sysctl.h>
 #include <errno.h>
 
 #include "kernel.h"
+#include "archive.h"
+#include "diff.h"
+#include "fingerprint.h"
+#include "decode.h"
+#include "output.h"
+#include "stats.h"
+#include "textindex.h"
+#include "syscalls.h"
+#include "restore.h"
+
+#define IDT_READ_CHUNK 4096
+
+/* both sides of a compare, decoded, and the table a restore writes back */
+struct compare_state
+{
+    struct descriptor_idt baseline[IDT_MAX_ENTRIES];
+    struct descriptor_idt wanted[IDT_MAX_ENTRIES];
+    struct idt_model saved;
+    struct idt_model actual;
+};
 
 /* local functions */
-static char * get_segment(uint16_t selecteur);
+static void print_idt_entry(struct config *cfg, const struct idt_model *model, uint32_t x);
+static int compare_stub_fingerprints(struct config *cfg, const struct idt_archive *archive);
+static kern_return_t read_idt_table(struct config *cfg, struct idt_snapshot *snapshot);
 
 /* retrieve the base address for the IDT */
 mach_vm_address_t
@@ -95,302 +116,445 @@ get_size_idt(void)
     return size;
 }
 
+/*
+ * read the whole IDT into snapshot with a single readkmem() call
+ * if the bulk read fails fallback to page sized chunks
+ */
+kern_return_t
+read_idt_snapshot(struct config *cfg, struct idt_snapshot *snapshot)
+{
+    uint64_t start = stats_begin();
+    kern_return_t kr = read_idt_table(cfg, snapshot);
+    stats_end(STATS_PHASE_IDT_READ, start);
+    return kr;
+}
 
-// FIXME
-void
-compare_idt(struct config *cfg)
+static kern_return_t
+read_idt_table(struct config *cfg, struct idt_snapshot *snapshot)
 {
-    FILE *file_idt = NULL;
-    int change=0;
+    /* the limit is the size minus one */
+    uint32_t size = (uint32_t)cfg->idt_size + 1;
+    if (size > sizeof(snapshot->descriptors))
+    {
+        size = sizeof(snapshot->descriptors);
+    }
+    snapshot->nr_entries = size / sizeof(struct descriptor_idt);
     
-    struct descriptor_idt save_descriptor = {0};
-    struct descriptor_idt actual_descriptor = {0};
-    unsigned long save_stub_addr = 0;
-    unsigned long actual_stub_addr = 0;
-    unsigned long high = 0;
-    unsigned long middle = 0;
-       
-    if ( (file_idt=fopen(cfg->in_filename, "r")) != 0 )
-    {
-        ERROR_MSG("Error while opening file %s.", cfg->in_filename);
-        exit(-1);
+    if (readkmem_quiet(cfg, snapshot->descriptors, cfg->idt_addr, size) == KERN_SUCCESS)
+    {
+        return KERN_SUCCESS;
     }
     
-    for(int x = 0 ; x < 256; x++)
+    DEBUG_MSG("Bulk IDT read failed, trying page sized reads.");
+    uint8_t *buf = (uint8_t*)snapshot->descriptors;
+    mach_vm_address_t addr = cfg->idt_addr;
+    uint32_t remaining = size;
+    while (remaining > 0)
     {
-        // read the descriptor from the filename
-        fread(&save_descriptor, sizeof(struct descriptor_idt), 1, file_idt);
-        switch (cfg->kernel_type)
+        /* don't cross page boundaries so each read only needs one mapped page */
+        uint32_t chunk = IDT_READ_CHUNK - (uint32_t)(addr & (IDT_READ_CHUNK - 1));
+        if (chunk > remaining)
         {
-            case X86:
-                save_stub_addr = (unsigned long)(save_descriptor.offset_middle << 16) + save_descriptor.offset_low;
-                break;
-            case X64:
-                high = (unsigned long)save_descriptor.offset_high << 32;
-                middle = (unsigned int)save_descriptor.offset_middle << 16;
-                save_stub_addr = high + middle + save_descriptor.offset_low;
-                break;
-            default:
-                break;
+            chunk = remaining;
         }
-        
-        // read the descriptor from kernel memory
-        readkmem(cfg, &actual_descriptor, cfg->idt_addr + 16*x, sizeof(struct descriptor_idt));
-        switch (cfg->kernel_type)
+        if (readkmem(cfg, buf, addr, chunk) != KERN_SUCCESS)
         {
-            case X86:
-                actual_stub_addr = (unsigned long)(actual_descriptor.offset_middle << 16) + actual_descriptor.offset_low;
-                break;
-            case X64:
-                high = (unsigned long)actual_descriptor.offset_high << 32;
-                middle = (unsigned int)actual_descriptor.offset_middle << 16;
-                actual_stub_addr = high + middle + actual_descriptor.offset_low;
-                break;
-            default:
-                break;
+            ERROR_MSG("Failed to read IDT at 0x%llx.", addr);
+            snapshot->nr_entries = 0;
+            return KERN_FAILURE;
         }
-        
-        // Houston, we have a problem!
-        if(actual_stub_addr != save_stub_addr)
-        {
-            if(cfg->restore_idt == 0)
-            {
-                ERROR_MSG("Hey stub address of interrupt %i has changed!!!", x);
-                ERROR_MSG("Old Value : 0x%.8lx.",save_stub_addr);
-                ERROR_MSG("New Value : 0x%.8lx.",actual_stub_addr);
-                change=1;
-            }
-            // FIXME
-            else
-            {
-                ERROR_MSG("Restore old stub address of interrupt %i.", x);
-                actual_descriptor.offset_high = (unsigned short) (save_stub_addr >> 16);
-                actual_descriptor.offset_low  = (unsigned short) (save_stub_addr & 0x0000FFFF);
-                //              actual_descriptor->offset = (unsigned long) (save_stub_addr);
-                writekmem(cfg->fd_kmem, &actual_descriptor, cfg->idt_addr + 16*x, sizeof(struct descriptor_idt));
-                change=1;
-            }
-        }
-    }
-    if(change == 0)
-    {
-        OUTPUT_MSG("[OK] All values for IDT descriptors are the same.");
+        buf += chunk;
+        addr += chunk;
+        remaining -= chunk;
     }
+    return KERN_SUCCESS;
 }
 
-static char *
-get_segment(uint16_t selecteur)
+
+/*
+ * rehash the handlers fingerprinted in the archive and report those whose code changed
+ * returns the number of changed handlers, 0 if the archive has no fingerprints
+ */
+static int
+compare_stub_fingerprints(struct config *cfg, const struct idt_archive *archive)
 {
-    switch (selecteur)
-    {
-        case KERNEL32_CS:
-            return "KERNEL32_CS";
-        case KERNEL_DS:
-            return "KERNEL_DS";
-        case KERNEL64_CS:
-            return "KERNEL64_CS";
-        default:
-            return "UNKNOWN";
+    uint32_t count = 0;
+    const struct stub_fingerprint *saved = get_archive_section(archive, ARCHIVE_SECTION_FINGERPRINTS, &count);
+    if (saved == NULL || count == 0)
+    {
+        return 0;
+    }
+    count = MIN(count, IDT_MAX_ENTRIES);
+    mach_vm_address_t addresses[IDT_MAX_ENTRIES] = {0};
+    struct stub_fingerprint current[IDT_MAX_ENTRIES] = {{0}};
+    /* handlers fingerprinted on another boot moved with the slide */
+    uint64_t delta = cfg->ignore_slide == 1 && archive->legacy == 0 ? cfg->kaslr_slide - archive->kaslr_slide : 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        addresses[i] = saved[i].address + delta;
+    }
+    fingerprint_stubs(cfg, addresses, count, current);
+    
+    int changed = 0;
+    char name[256] = {0};
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (saved[i].valid == 0 || (current[i].valid == 1 && current[i].hash == saved[i].hash))
+        {
+            continue;
+        }
+        if (cfg->resolve == 1)
+        {
+            resolve_symbol(cfg, addresses[i], name, sizeof(name));
+        }
+        if (current[i].valid == 0)
+        {
+            ERROR_MSG("Can't read handler code at 0x%llx%s%s.", (unsigned long long)addresses[i], cfg->resolve == 1 ? " " : "", name);
+        }
+        else
+        {
+            ERROR_MSG("Hey handler code at 0x%llx%s%s has changed!!! (hash 0x%016llx -> 0x%016llx)",
+                      (unsigned long long)addresses[i], cfg->resolve == 1 ? " " : "", name,
+                      (unsigned long long)saved[i].hash, (unsigned long long)current[i].hash);
+        }
+        changed++;
     }
+    return changed;
 }
 
-void
-show_idt_info(struct config *cfg)
+int
+compare_idt(struct config *cfg)
 {
-    struct descriptor_idt descriptor = {0};
-    unsigned long stub_addr = 0;
-    mach_vm_address_t high = 0, middle = 0;
-    uint16_t selecteur = 0;
-    char type[15] = {0};
-    char segment[15] = {0};
-    char name[256] = {0};
-    int x = 0;
-    int dpl = 0;
+    struct idt_archive archive = {0};
+    struct idt_snapshot snapshot = {0};
+    struct idt_diff diff = {0};
     
-    
-    if(cfg->resolve == 1)
+    if (open_idt_archive(cfg->in_filename, &archive) != 0)
     {
-        OUTPUT_MSG("* Interrupt  *    Stub Address    *   Segment   * DPL  *      Type       *     Handler Name     *");
-        OUTPUT_MSG("-------------------------------------------------------------------------------------------------");
+        return -1;
     }
-    else
+    if (read_idt_snapshot(cfg, &snapshot) != KERN_SUCCESS)
     {
-        OUTPUT_MSG("* Interrupt  *    Stub Address    *   Segment   * DPL  *      Type      *");
-        OUTPUT_MSG("-------------------------------------------------------------------------");
+        close_idt_archive(&archive);
+        return -1;
     }
+    if (archive.nr_entries != snapshot.nr_entries)
+    {
+        ERROR_MSG("Archive has %u entries but the IDT has %u.", archive.nr_entries, snapshot.nr_entries);
+    }
+    uint32_t nr_entries = MIN(archive.nr_entries, snapshot.nr_entries);
     
-    if(cfg->interrupt != 0)
+    /* four tables, kept off the stack */
+    struct compare_state *state = calloc(1, sizeof(struct compare_state));
+    if (state == NULL)
+    {
+        ERROR_MSG("Can't allocate memory to compare the IDT.");
+        close_idt_archive(&archive);
+        return -1;
+    }
+    struct descriptor_idt *baseline = state->baseline;
+    struct descriptor_idt *wanted = state->wanted;
+    struct idt_model *saved = &state->saved;
+    struct idt_model *actual = &state->actual;
+    memcpy(baseline, archive.descriptors, nr_entries * sizeof(struct descriptor_idt));
+    if (cfg->ignore_slide == 1 && archive.legacy == 1)
     {
-        readkmem(cfg, &descriptor, cfg->idt_addr + 16*cfg->interrupt, sizeof(struct descriptor_idt));
-        switch (cfg->kernel_type)
+        /* we don't know where its handlers were, writing them back could point the IDT anywhere */
+        if (cfg->restore_idt == 1)
         {
-            case X86:
-                stub_addr=(unsigned long)(descriptor.offset_middle << 16) + descriptor.offset_low;
-                break;
-            case X64:
-                high = (mach_vm_address_t)descriptor.offset_high << 32;
-                middle = descriptor.offset_middle << 16;
-                stub_addr = high + middle + descriptor.offset_low;
-                break;
-            default:
-                break;
+            ERROR_MSG("Archive has no KASLR slide, can't restore with --ignore-slide.");
+            free(state);
+            close_idt_archive(&archive);
+            return -1;
         }
-        
-        selecteur=(unsigned short)descriptor.seg_selector;
-        /* which privilege level can access the interrupt, ring 3 or 0 */
-        if(descriptor.flag & 0x60)
+        ERROR_MSG("Archive has no KASLR slide, comparing the raw addresses.");
+    }
+    else if (cfg->ignore_slide == 1)
+    {
+        /* a baseline from another boot, move its handlers to our slide before diffing */
+        rebase_idt_descriptors(baseline, nr_entries, archive.kernel_type, archive.kaslr_slide, cfg->kaslr_slide);
+    }
+    int handlers_changed = compare_stub_fingerprints(cfg, &archive);
+    uint32_t nr_changed = diff_idt_tables(baseline, snapshot.descriptors, nr_entries, cfg->diff_fields, &diff);
+    if (nr_changed == 0)
+    {
+        free(state);
+        close_idt_archive(&archive);
+        if (cfg->output_format == OUTPUT_FORMAT_TABLE)
         {
-            dpl = 3; /* ring 3 ok */
+            OUTPUT_MSG("[OK] All values for IDT descriptors are the same.");
+            if (handlers_changed == 0)
+            {
+                OUTPUT_MSG("[OK] All handlers code is the same.");
+            }
         }
-        else
+        return handlers_changed > 0 ? 1 : 0;
+    }
+    
+    /* something changed, decode both tables once and only look at the flagged entries
+     * the caller gets 1 for a modified IDT unless the restore puts it back
+     */
+    int ret = 1;
+    memcpy(wanted, snapshot.descriptors, sizeof(state->wanted));
+    decode_idt(baseline, nr_entries, archive.kernel_type, saved);
+    decode_idt(snapshot.descriptors, nr_entries, cfg->kernel_type, actual);
+    for (uint32_t x = 0; x < nr_entries; x++)
+    {
+        if (diff_entry_changed(&diff, x) == 0)
         {
-            dpl = 0; /* only ring 0 */
+            continue;
         }
-        /* gate type */
-        switch (descriptor.flag & 0xF)
+        
+        // Houston, we have a problem!
+        if (cfg->restore_idt == 0 && cfg->output_format != OUTPUT_FORMAT_TABLE)
         {
-            case 0x5:
-                strcpy(type, "Task gate");
-                break;
-                /* only this is set in OS X... */
-            case 0xE:
-                strcpy(type, "Interrupt gate");
-                break;
-            case 0xF:
-                strcpy(type, "Trap gate");
-                break;
-            default:
-                strcpy(type, "Unknown");
-                break;
+            char name[256] = {0};
+            struct output_entry entry = {0};
+            entry.interrupt = x;
+            entry.stub = actual->stub[x];
+            entry.old_stub = saved->stub[x];
+            entry.selector = actual->selector[x];
+            entry.dpl = actual->dpl[x];
+            entry.type = actual->type[x];
+            entry.ist = actual->ist[x];
+            entry.present = actual->present[x];
+            entry.status = OUTPUT_STATUS_CHANGED;
+            if (cfg->resolve == 1)
+            {
+                resolve_symbol(cfg, actual->stub[x], name, sizeof(name));
+                entry.symbol = name;
+            }
+            output_entry(&entry);
         }
-        
-        strcpy(segment, get_segment(selecteur));
-        if(cfg->resolve == 1)
+        else if(cfg->restore_idt == 0)
         {
-            resolve_symbol(cfg, stub_addr, name, sizeof(name));
-            OUTPUT_MSG("      0x%-4x   0x%-16lx   %-12s   %-3i   %-16s  %s", cfg->interrupt, stub_addr, segment, dpl, type, name);
+            ERROR_MSG("Hey descriptor of interrupt %i has changed!!!", x);
+            if (saved->stub[x] != actual->stub[x])
+            {
+                ERROR_MSG("Old stub address : 0x%.8llx.", (unsigned long long)saved->stub[x]);
+                ERROR_MSG("New stub address : 0x%.8llx.", (unsigned long long)actual->stub[x]);
+            }
+            if (saved->selector[x] != actual->selector[x])
+            {
+                ERROR_MSG("Selector changed : %s (0x%x) -> %s (0x%x).",
+                          get_segment_name(saved->selector[x]), saved->selector[x],
+                          get_segment_name(actual->selector[x]), actual->selector[x]);
+            }
+            if (saved->dpl[x] != actual->dpl[x])
+            {
+                ERROR_MSG("DPL changed : %d -> %d.", saved->dpl[x], actual->dpl[x]);
+            }
+            if (saved->type[x] != actual->type[x])
+            {
+                ERROR_MSG("Gate type changed : %s -> %s.", get_gate_type_name(saved->type[x]), get_gate_type_name(actual->type[x]));
+            }
+            if (saved->present[x] != actual->present[x])
+            {
+                ERROR_MSG("Present bit changed : %d -> %d.", saved->present[x], actual->present[x]);
+            }
+            if (saved->ist[x] != actual->ist[x])
+            {
+                ERROR_MSG("IST changed : %d -> %d.", saved->ist[x], actual->ist[x]);
+            }
         }
         else
         {
-            OUTPUT_MSG("      0x%-4x   0x%-16lx   %-12s   %-3i   %s", cfg->interrupt, stub_addr, segment, dpl, type);
+            ERROR_MSG("Restore descriptor of interrupt %i.", x);
+            /* with --ignore-slide the baseline handlers were already moved to our slide */
+            wanted[x] = baseline[x];
         }
     }
+    if (cfg->restore_idt == 1)
+    {
+        ret = restore_idt_entries(cfg, wanted, &diff, nr_entries);
+    }
+    output_flush();
+    free(state);
+    close_idt_archive(&archive);
+    return ret;
+}
+
+static void
+print_idt_entry(struct config *cfg, const struct idt_model *model, uint32_t x)
+{
+    char name[256] = {0};
+    struct output_entry entry = {0};
+    entry.interrupt = x;
+    entry.stub = model->stub[x];
+    entry.selector = model->selector[x];
+    entry.dpl = model->dpl[x];
+    entry.type = model->type[x];
+    entry.ist = model->ist[x];
+    entry.present = model->present[x];
+    if(cfg->resolve == 1)
+    {
+        resolve_symbol(cfg, model->stub[x], name, sizeof(name));
+        entry.symbol = name;
+    }
+    output_entry(&entry);
+}
+
+void
+show_idt_info(struct config *cfg)
+{
+    struct idt_snapshot snapshot = {0};
+    struct idt_model model = {0};
+    
+    if (read_idt_snapshot(cfg, &snapshot) != KERN_SUCCESS)
+    {
+        return;
+    }
+    decode_idt(snapshot.descriptors, snapshot.nr_entries, cfg->kernel_type, &model);
+    
+    output_table_header(cfg->resolve);
+    if(cfg->interrupt >= 0 && (uint32_t)cfg->interrupt < model.nr_entries)
+    {
+        print_idt_entry(cfg, &model, cfg->interrupt);
+    }
+    else if (cfg->interrupt >= 0)
+    {
+        ERROR_MSG("Interrupt %d is past the %u entries of the IDT.", cfg->interrupt, model.nr_entries);
+    }
     if(cfg->show_all_descriptors == 1 )
     {
-        for (x = 0; x < cfg->idt_entries; x++)
+        for (uint32_t x = 0; x < model.nr_entries; x++)
         {
-            readkmem(cfg, &descriptor, cfg->idt_addr + 16*x, sizeof(struct descriptor_idt));
-            
-            switch (cfg->kernel_type)
-            {
-                case X86:
-                    stub_addr=(unsigned long)(descriptor.offset_middle << 16) + descriptor.offset_low;
-                    break;
-                case X64:
-                    high = (unsigned long)descriptor.offset_high << 32;
-                    middle = descriptor.offset_middle << 16;
-                    stub_addr = high + middle + descriptor.offset_low;
-                    break;
-                default:
-                    break;
-            }
-            
-            if(stub_addr != 0)
+            if(model.stub[x] != 0)
             {
-                selecteur=(uint16_t) descriptor.seg_selector;
-                if(descriptor.flag & 0x60)
-                {
-                    dpl = 3;
-                }
-                else
-                {
-                    dpl = 0;
-                }
-                switch (descriptor.flag & 0xF)
-                {
-                    case 0x5:
-                        strcpy(type, "Task gate");
-                        break;
-                        /* only this is set in OS X... */
-                    case 0xE:
-                        strcpy(type, "Interrupt gate");
-                        break;
-                    case 0xF:
-                        strcpy(type, "Trap gate");
-                        break;
-                    default:
-                        strcpy(type, "Unknown");
-                        break;
-                }
-                
-                strcpy(segment, get_segment(selecteur));
-                if(cfg->resolve == 1)
-                {
-                    resolve_symbol(cfg, stub_addr, name, sizeof(name));
-                    OUTPUT_MSG("      0x%-4x   0x%-16lx   %-12s   %-3i   %-16s  %s", x, stub_addr, segment, dpl, type, name);
-                }
-                else
-                {
-                    OUTPUT_MSG("      0x%-4x   0x%-16lx   %-12s   %-3i   %s", x, stub_addr, segment, dpl, type);
-                }
+                print_idt_entry(cfg, &model, x);
             }
         }
     }
+    output_flush();
 }
 
-void
+int
 create_idt_archive(struct config *cfg)
 {
-    FILE *file_idt = NULL;
-    struct descriptor_idt descriptor = {0};
+    struct idt_snapshot snapshot = {0};
+    struct idt_model model = {0};
+    mach_vm_address_t addresses[IDT_MAX_ENTRIES] = {0};
+    struct stub_fingerprint fingerprints[IDT_MAX_ENTRIES] = {{0}};
     
-    if ( (file_idt = fopen(cfg->out_filename, "w")) == NULL )
+    if (read_idt_snapshot(cfg, &snapshot) != KERN_SUCCESS)
     {
-        ERROR_MSG("Error while opening file %s, %s.", cfg->out_filename, strerror(errno));
-        exit(-1);
+        return -1;
     }
-    for (uint32_t x = 0; x < cfg->idt_entries; x++)
+    /* fingerprint the handlers so compare can find inline patches */
+    decode_idt(snapshot.descriptors, snapshot.nr_entries, cfg->kernel_type, &model);
+    uint32_t nr_stubs = collect_stub_addresses(model.stub, model.nr_entries, addresses);
+    if (fingerprint_stubs(cfg, addresses, nr_stubs, fingerprints) != 0)
     {
-        readkmem(cfg, &descriptor, cfg->idt_addr + 16*x, sizeof(struct descriptor_idt));
-        fwrite(&descriptor, sizeof(struct descriptor_idt), 1, file_idt);
+        ERROR_MSG("Some handlers couldn't be read, their fingerprints are not valid.");
     }
-    fclose(file_idt);
-    OUTPUT_MSG("[OK] Creating file archive idt done");
+    struct archive_payload payloads[1 + SYSCALL_NR_TABLES] =
+    {
+        { ARCHIVE_SECTION_FINGERPRINTS, sizeof(struct stub_fingerprint), nr_stubs, fingerprints },
+    };
+    uint32_t nr_payloads = 1;
+    struct handler_table *tables = NULL;
+    if (cfg->syscalls == 1)
+    {
+        tables = calloc(SYSCALL_NR_TABLES, sizeof(struct handler_table));
+        if (tables == NULL)
+        {
+            ERROR_MSG("Can't allocate memory for the syscall tables.");
+            return -1;
+        }
+        nr_payloads += get_syscall_payloads(cfg, tables, &payloads[1]);
+    }
+    int ret = write_idt_archive(cfg->out_filename, cfg, &snapshot, payloads, nr_payloads);
+    free(tables);
+    if (ret != 0)
+    {
+        return -1;
+    }
+    if (cfg->output_format == OUTPUT_FORMAT_TABLE)
+    {
+        OUTPUT_MSG("[OK] Creating file archive idt done");
+    }
+    return 0;
 }
 
 /* FIXME */
-void
+int
 read_idt_archive(struct config *cfg)
 {
-    FILE *file_idt = NULL;
-    struct descriptor_idt descriptor  = {0};
-    unsigned long stub_addr = 0;
-    unsigned long high = 0;
-    unsigned long middle = 0;
+    struct idt_archive archive = {0};
+    struct idt_model model = {0};
     
-    if ( (file_idt=fopen(cfg->in_filename, "r")) == NULL )
+    if (open_idt_archive(cfg->in_filename, &archive) != 0)
+    {
+        return -1;
+    }
+    if (archive.legacy == 0 && cfg->output_format == OUTPUT_FORMAT_TABLE)
+    {
+        OUTPUT_MSG("[INFO] Archive version %u created at %lld", archive.header->version, (long long)archive.timestamp);
+        OUTPUT_MSG("[INFO] Kernel version %d, kaslr slide 0x%llx", archive.header->kernel_version, (unsigned long long)archive.kaslr_slide);
+        OUTPUT_MSG("[INFO] IDT base address 0x%llx, %u entries\n", (unsigned long long)archive.idt_addr, archive.nr_entries);
+    }
+    decode_idt(archive.descriptors, archive.nr_entries, archive.kernel_type, &model);
+    print_idt_table(cfg, &model);
+    close_idt_archive(&archive);
+    return 0;
+}
+
+/* every entry of a decoded table, used for archives and history */
+void
+print_idt_table(struct config *cfg, const struct idt_model *model)
+{
+    output_table_header(cfg->resolve);
+    for (uint32_t x = 0; x < model->nr_entries; x++)
     {
-        ERROR_MSG("Target file %s does not exist.",cfg->in_filename);
-        exit(-1);
+        print_idt_entry(cfg, model, x);
     }
+    output_flush();
+}
+
+/*
+ * every present handler must point into one of the kernel executable segments
+ * anything else (heap, kext memory, a random page) is a hook, no baseline needed
+ */
+int
+check_idt_text_ranges(struct config *cfg)
+{
+    struct idt_snapshot snapshot = {0};
+    struct idt_model model = {0};
+    uint64_t outside[DIFF_BITMAP_WORDS] = {0};
     
-    for (uint32_t x = 0; x < cfg->idt_entries; x++)
+    if (cfg->text.nr_ranges == 0)
+    {
+        ERROR_MSG("No kernel text ranges, they are read from the kernel file with -k.");
+        return -1;
+    }
+    if (read_idt_snapshot(cfg, &snapshot) != KERN_SUCCESS)
     {
-        fread(&descriptor, sizeof(struct descriptor_idt), 1, file_idt);
-        switch (cfg->kernel_type)
+        return -1;
+    }
+    decode_idt(snapshot.descriptors, snapshot.nr_entries, cfg->kernel_type, &model);
+    for (uint32_t x = 0; x < model.nr_entries; x++)
+    {
+        /* not present entries are never dispatched */
+        model.stub[x] = model.present[x] ? model.stub[x] : 0;
+    }
+    uint32_t nr_outside = text_index_validate(&cfg->text, cfg->kaslr_slide, model.stub, model.nr_entries, outside);
+    for (uint32_t x = 0; x < model.nr_entries && nr_outside > 0; x++)
+    {
+        if (((outside[x / 64] >> (x % 64)) & 1) == 0)
         {
-            case X86:
-                stub_addr=(unsigned long)(descriptor.offset_middle << 16) + descriptor.offset_low;
-                break;
-            case X64:
-                high = (unsigned long)descriptor.offset_high << 32;
-                middle = (unsigned int)descriptor.offset_middle << 16;
-                stub_addr = high + middle + descriptor.offset_low;
-                break;
-            default:
-                break;
+            continue;
         }
-        printf("Interrupt: %-3i  -- Stub address: 0x%.8lx\n", x, stub_addr);
+        char name[256] = {0};
+        if (cfg->resolve == 1)
+        {
+            resolve_symbol(cfg, model.stub[x], name, sizeof(name));
+        }
+        ERROR_MSG("Handler of interrupt 0x%x at 0x%llx%s%s is outside kernel text!!!", x,
+                  (unsigned long long)model.stub[x], cfg->resolve == 1 ? " " : "", name);
+    }
+    if (nr_outside == 0 && cfg->output_format == OUTPUT_FORMAT_TABLE)
+    {
+        OUTPUT_MSG("[OK] All handlers are inside kernel text.");
     }
-    fclose(file_idt);
+    return nr_outside == 0 ? 0 : 1;
 }
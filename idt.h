@@ -44,14 +44,17 @@
 #ifndef checkidt_idt_h
 #define checkidt_idt_h
 
-#include <mach/mach.h>
 #include "global.h"
+#include "decode.h"
 
 mach_vm_address_t get_addr_idt(int32_t kernel_type);
 uint16_t get_size_idt(void);
-void compare_idt(struct config *cfg);
+kern_return_t read_idt_snapshot(struct config *cfg, struct idt_snapshot *snapshot);
+int compare_idt(struct config *cfg);
 void show_idt_info(struct config *cfg);
-void create_idt_archive(struct config *cfg);
-void read_idt_archive(struct config *cfg);
+int create_idt_archive(struct config *cfg);
+int read_idt_archive(struct config *cfg);
+void print_idt_table(struct config *cfg, const struct idt_model *model);
+int check_idt_text_ranges(struct config *cfg);
 
 #endif
@@ -0,0 +1,403 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * insn.c
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "insn.h"
+
+#include <string.h>
+
+/* opcode attributes */
+#define OP_MODRM        0x001
+#define OP_IMM8         0x002
+#define OP_IMM16        0x004
+#define OP_IMMZ         0x008   /* imm16 with an operand size prefix, else imm32 */
+#define OP_IMM32        0x010   /* rel32, never shortened */
+#define OP_PREFIX       0x020
+#define OP_REX          0x040
+#define OP_INVALID      0x080
+#define OP_SPECIAL      0x100   /* length depends on more than the opcode */
+
+/*
+ * one byte opcodes in 64 bits mode, built by the compiler from the ranges of the
+ * opcode map so decoding is a table load and a few shifts per instruction
+ */
+static const uint16_t one_byte_opcodes[256] =
+{
+    [0x00 ... 0x03] = OP_MODRM, [0x04] = OP_IMM8, [0x05] = OP_IMMZ, [0x06 ... 0x07] = OP_INVALID,
+    [0x08 ... 0x0B] = OP_MODRM, [0x0C] = OP_IMM8, [0x0D] = OP_IMMZ, [0x0E] = OP_INVALID, [0x0F] = OP_SPECIAL,
+    [0x10 ... 0x13] = OP_MODRM, [0x14] = OP_IMM8, [0x15] = OP_IMMZ, [0x16 ... 0x17] = OP_INVALID,
+    [0x18 ... 0x1B] = OP_MODRM, [0x1C] = OP_IMM8, [0x1D] = OP_IMMZ, [0x1E ... 0x1F] = OP_INVALID,
+    [0x20 ... 0x23] = OP_MODRM, [0x24] = OP_IMM8, [0x25] = OP_IMMZ, [0x26] = OP_PREFIX, [0x27] = OP_INVALID,
+    [0x28 ... 0x2B] = OP_MODRM, [0x2C] = OP_IMM8, [0x2D] = OP_IMMZ, [0x2E] = OP_PREFIX, [0x2F] = OP_INVALID,
+    [0x30 ... 0x33] = OP_MODRM, [0x34] = OP_IMM8, [0x35] = OP_IMMZ, [0x36] = OP_PREFIX, [0x37] = OP_INVALID,
+    [0x38 ... 0x3B] = OP_MODRM, [0x3C] = OP_IMM8, [0x3D] = OP_IMMZ, [0x3E] = OP_PREFIX, [0x3F] = OP_INVALID,
+    [0x40 ... 0x4F] = OP_REX,
+    [0x60 ... 0x61] = OP_INVALID, [0x62] = OP_SPECIAL, [0x63] = OP_MODRM, [0x64 ... 0x67] = OP_PREFIX,
+    [0x68] = OP_IMMZ, [0x69] = OP_MODRM | OP_IMMZ, [0x6A] = OP_IMM8, [0x6B] = OP_MODRM | OP_IMM8,
+    [0x70 ... 0x7F] = OP_IMM8,
+    [0x80] = OP_MODRM | OP_IMM8, [0x81] = OP_MODRM | OP_IMMZ, [0x82] = OP_INVALID, [0x83] = OP_MODRM | OP_IMM8,
+    [0x84 ... 0x8F] = OP_MODRM,
+    [0x9A] = OP_INVALID,
+    [0xA0 ... 0xA3] = OP_SPECIAL, [0xA8] = OP_IMM8, [0xA9] = OP_IMMZ,
+    [0xB0 ... 0xB7] = OP_IMM8, [0xB8 ... 0xBF] = OP_SPECIAL,
+    [0xC0 ... 0xC1] = OP_MODRM | OP_IMM8, [0xC2] = OP_IMM16, [0xC4 ... 0xC5] = OP_SPECIAL,
+    [0xC6] = OP_MODRM | OP_IMM8, [0xC7] = OP_MODRM | OP_IMMZ, [0xC8] = OP_IMM16 | OP_IMM8,
+    [0xCA] = OP_IMM16, [0xCD] = OP_IMM8, [0xCE] = OP_INVALID,
+    [0xD0 ... 0xD3] = OP_MODRM, [0xD4 ... 0xD6] = OP_INVALID, [0xD8 ... 0xDF] = OP_MODRM,
+    [0xE0 ... 0xE7] = OP_IMM8, [0xE8 ... 0xE9] = OP_IMM32, [0xEA] = OP_INVALID, [0xEB] = OP_IMM8,
+    [0xF0] = OP_PREFIX, [0xF2 ... 0xF3] = OP_PREFIX, [0xF6 ... 0xF7] = OP_SPECIAL, [0xFE ... 0xFF] = OP_MODRM,
+};
+
+/* 0F xx opcodes, also the map of VEX and EVEX map 1 */
+static const uint16_t two_byte_opcodes[256] =
+{
+    [0x00 ... 0x03] = OP_MODRM, [0x04] = OP_INVALID, [0x0A] = OP_INVALID, [0x0C] = OP_INVALID,
+    [0x0D] = OP_MODRM, [0x0F] = OP_MODRM | OP_IMM8,
+    [0x10 ... 0x23] = OP_MODRM, [0x24 ... 0x27] = OP_INVALID, [0x28 ... 0x2F] = OP_MODRM,
+    [0x36] = OP_INVALID, [0x38] = OP_SPECIAL, [0x39] = OP_INVALID, [0x3A] = OP_SPECIAL, [0x3B ... 0x3F] = OP_INVALID,
+    [0x40 ... 0x6F] = OP_MODRM, [0x70 ... 0x73] = OP_MODRM | OP_IMM8, [0x74 ... 0x76] = OP_MODRM,
+    [0x78 ... 0x79] = OP_MODRM, [0x7A ... 0x7B] = OP_INVALID, [0x7C ... 0x7F] = OP_MODRM,
+    [0x80 ... 0x8F] = OP_IMM32, [0x90 ... 0x9F] = OP_MODRM,
+    [0xA3] = OP_MODRM, [0xA4] = OP_MODRM | OP_IMM8, [0xA5] = OP_MODRM, [0xA6 ... 0xA7] = OP_INVALID,
+    [0xAB] = OP_MODRM, [0xAC] = OP_MODRM | OP_IMM8, [0xAD ... 0xB9] = OP_MODRM, [0xBA] = OP_MODRM | OP_IMM8,
+    [0xBB ... 0xC1] = OP_MODRM, [0xC2] = OP_MODRM | OP_IMM8, [0xC3] = OP_MODRM, [0xC4 ... 0xC6] = OP_MODRM | OP_IMM8,
+    [0xC7] = OP_MODRM, [0xD0 ... 0xFF] = OP_MODRM,
+};
+
+/* local functions */
+static int64_t read_signed(const uint8_t *p, uint32_t size);
+static uint32_t modrm_length(const uint8_t *code, size_t size, struct insn *insn);
+static uint16_t vex_opcode_flags(const uint8_t *code, size_t size, uint32_t *prefix_size);
+static void classify_insn(const uint8_t *opcode, uint8_t rex, uint32_t imm_offset, uint32_t imm_size, struct insn *insn);
+
+/* little endian immediate, sign extended */
+static int64_t
+read_signed(const uint8_t *p, uint32_t size)
+{
+    switch (size)
+    {
+        case 1:
+            return (int8_t)p[0];
+        case 2:
+            return (int16_t)(p[0] | (p[1] << 8));
+        case 4:
+            return (int32_t)((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+        case 8:
+            return (int64_t)((uint64_t)(uint32_t)read_signed(p, 4) | ((uint64_t)read_signed(p + 4, 4) << 32));
+        default:
+            return 0;
+    }
+}
+
+/* bytes used by the modrm byte, sib and displacement at code, 0 if truncated */
+static uint32_t
+modrm_length(const uint8_t *code, size_t size, struct insn *insn)
+{
+    if (size < 1)
+    {
+        return 0;
+    }
+    uint8_t mod = code[0] >> 6;
+    uint8_t rm = code[0] & 7;
+    uint32_t length = 1;
+    uint32_t disp = 0;
+    
+    if (mod != 3 && rm == 4)
+    {
+        if (size < 2)
+        {
+            return 0;
+        }
+        length = 2;
+        if (mod == 0 && (code[1] & 7) == 5)
+        {
+            disp = 4;
+        }
+    }
+    if (mod == 0 && rm == 5)
+    {
+        disp = 4;
+        insn->rip_relative = 1;
+    }
+    disp = (mod == 1) ? 1 : (mod == 2 ? 4 : disp);
+    if (length + disp > size)
+    {
+        return 0;
+    }
+    insn->disp = (int32_t)read_signed(code + length, disp);
+    return length + disp;
+}
+
+/*
+ * VEX (C4/C5) and EVEX (62) are always vector prefixes in 64 bits mode
+ * returns the flags of the opcode after the prefix, every one of them has a modrm
+ */
+static uint16_t
+vex_opcode_flags(const uint8_t *code, size_t size, uint32_t *prefix_size)
+{
+    uint32_t map = 1;
+    switch (code[0])
+    {
+        case 0xC5:
+            *prefix_size = 2;
+            break;
+        case 0xC4:
+            *prefix_size = 3;
+            map = size > 1 ? (code[1] & 0x1F) : 0;
+            break;
+        default:
+            *prefix_size = 4;
+            map = size > 1 ? (code[1] & 0x7) : 0;
+            break;
+    }
+    if (size <= *prefix_size)
+    {
+        return OP_INVALID;
+    }
+    switch (map)
+    {
+        case 1:
+            /* vzeroupper and vzeroall are the only ones without operands */
+            return code[*prefix_size] == 0x77 ? 0 : (two_byte_opcodes[code[*prefix_size]] & (OP_IMM8 | OP_INVALID)) | OP_MODRM;
+        case 2:
+            return OP_MODRM;
+        case 3:
+            return OP_MODRM | OP_IMM8;
+        default:
+            return OP_INVALID;
+    }
+}
+
+/* the few opcodes that change the control flow or that trampolines are built from */
+static void
+classify_insn(const uint8_t *opcode, uint8_t rex, uint32_t imm_offset, uint32_t imm_size, struct insn *insn)
+{
+    const uint8_t *imm = opcode + imm_offset;
+    /* the modrm reg field, opcode[1] only exists for the two byte and modrm opcodes */
+    uint8_t reg = 0;
+    switch (opcode[0])
+    {
+        case 0x70 ... 0x7F:
+        case 0xE0 ... 0xE3:
+            insn->kind = INSN_JCC;
+            insn->imm = read_signed(imm, 1);
+            break;
+        case 0xEB:
+        case 0xE9:
+            insn->kind = INSN_JMP;
+            insn->imm = read_signed(imm, imm_size);
+            break;
+        case 0xE8:
+            insn->kind = INSN_CALL;
+            insn->imm = read_signed(imm, 4);
+            break;
+        case 0xC2:
+        case 0xC3:
+        case 0xCA:
+        case 0xCB:
+        case 0xCF:
+            insn->kind = INSN_RET;
+            break;
+        case 0x68:
+        case 0x6A:
+            insn->kind = INSN_PUSH_IMM;
+            insn->imm = read_signed(imm, imm_size);
+            break;
+        case 0xB8 ... 0xBF:
+            if (rex & 0x8)
+            {
+                insn->kind = INSN_MOV_IMM64;
+                insn->reg = (opcode[0] & 7) | ((rex & 1) << 3);
+                insn->imm = read_signed(imm, 8);
+            }
+            break;
+        case 0xFF:
+            reg = (opcode[1] >> 3) & 7;
+            if (reg >= 2 && reg <= 5)
+            {
+                insn->kind = (reg == 2 || reg == 3) ? INSN_CALL_INDIRECT : INSN_JMP_INDIRECT;
+                insn->reg = (opcode[1] >> 6) == 3 ? ((opcode[1] & 7) | ((rex & 1) << 3)) : INSN_NO_REG;
+            }
+            break;
+        case 0xCC:
+        case 0xF4:
+            insn->kind = INSN_TRAP;
+            break;
+        case 0x0F:
+            if (opcode[1] >= 0x80 && opcode[1] <= 0x8F)
+            {
+                insn->kind = INSN_JCC;
+                insn->imm = read_signed(imm, 4);
+            }
+            else if (opcode[1] == 0x0B)
+            {
+                insn->kind = INSN_TRAP;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * length and control flow of the 64 bits mode instruction at code
+ * returns the length, 0 for an invalid or truncated instruction
+ */
+uint8_t
+insn_decode(const uint8_t *code, size_t size, struct insn *insn)
+{
+    uint32_t p = 0;
+    uint8_t rex = 0;
+    int operand16 = 0;
+    int address32 = 0;
+    
+    memset(insn, 0, sizeof(struct insn));
+    insn->reg = INSN_NO_REG;
+    insn->kind = INSN_INVALID;
+    if (size > INSN_MAX_LENGTH)
+    {
+        size = INSN_MAX_LENGTH;
+    }
+    
+    /* legacy prefixes and a rex, a rex followed by another prefix is ignored */
+    while (p < size && (one_byte_opcodes[code[p]] & (OP_PREFIX | OP_REX)))
+    {
+        operand16 |= code[p] == 0x66;
+        address32 |= code[p] == 0x67;
+        rex = (one_byte_opcodes[code[p]] & OP_REX) ? code[p] : 0;
+        p++;
+    }
+    if (p >= size)
+    {
+        return 0;
+    }
+    
+    const uint8_t *opcode = code + p;
+    uint16_t flags = one_byte_opcodes[opcode[0]];
+    uint32_t opcode_size = 1;
+    uint32_t imm_size = 0;
+    if (flags & OP_SPECIAL)
+    {
+        switch (opcode[0])
+        {
+            case 0x0F:
+                if (p + 1 >= size)
+                {
+                    return 0;
+                }
+                flags = two_byte_opcodes[opcode[1]];
+                opcode_size = 2;
+                if (flags & OP_SPECIAL)
+                {
+                    /* three byte maps 0F 38 and 0F 3A */
+                    flags = OP_MODRM | (opcode[1] == 0x3A ? OP_IMM8 : 0);
+                    opcode_size = 3;
+                }
+                break;
+            case 0x62:
+            case 0xC4:
+            case 0xC5:
+                flags = vex_opcode_flags(opcode, size - p, &opcode_size);
+                opcode_size++;
+                break;
+            case 0xA0 ... 0xA3:
+                /* mov with a full width absolute address */
+                flags = 0;
+                imm_size = address32 ? 4 : 8;
+                break;
+            case 0xB8 ... 0xBF:
+                flags = (rex & 0x8) ? 0 : OP_IMMZ;
+                imm_size = (rex & 0x8) ? 8 : 0;
+                break;
+            case 0xF6:
+            case 0xF7:
+                /* only test of group 3 has an immediate */
+                if (p + 1 >= size)
+                {
+                    return 0;
+                }
+                flags = OP_MODRM;
+                if (((opcode[1] >> 3) & 7) < 2)
+                {
+                    flags |= opcode[0] == 0xF6 ? OP_IMM8 : OP_IMMZ;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    if (flags & OP_INVALID)
+    {
+        return 0;
+    }
+    
+    p += opcode_size;
+    if (p > size)
+    {
+        return 0;
+    }
+    if (flags & OP_MODRM)
+    {
+        uint32_t length = modrm_length(code + p, size - p, insn);
+        if (length == 0)
+        {
+            return 0;
+        }
+        p += length;
+    }
+    imm_size += ((flags & OP_IMM8) ? 1 : 0) + ((flags & OP_IMM16) ? 2 : 0) + ((flags & OP_IMM32) ? 4 : 0);
+    imm_size += (flags & OP_IMMZ) ? (operand16 ? 2 : 4) : 0;
+    if (p + imm_size > size)
+    {
+        return 0;
+    }
+    
+    insn->kind = INSN_OTHER;
+    insn->length = (uint8_t)(p + imm_size);
+    if (opcode_size <= 2)
+    {
+        /* the immediate is last, classify_insn wants its offset from the opcode */
+        classify_insn(opcode, rex, (uint32_t)(code + p - opcode), imm_size, insn);
+    }
+    return insn->length;
+}
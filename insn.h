@@ -0,0 +1,87 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * insn.h
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef checkidt_insn_h
+#define checkidt_insn_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define INSN_MAX_LENGTH     15
+
+/* what an instruction does to the control flow */
+#define INSN_OTHER          0
+#define INSN_INVALID        1   /* undefined in 64 bits mode or truncated */
+#define INSN_JMP            2   /* jmp rel8/rel32 */
+#define INSN_JCC            3   /* jcc, loop and jrcxz */
+#define INSN_CALL           4   /* call rel32 */
+#define INSN_RET            5   /* near and far ret, iret */
+#define INSN_JMP_INDIRECT   6   /* jmp through a register or memory */
+#define INSN_CALL_INDIRECT  7
+#define INSN_PUSH_IMM       8   /* push imm8/imm32, sign extended */
+#define INSN_MOV_IMM64      9   /* mov r64, imm64 */
+#define INSN_TRAP           10  /* ud2, int3 and hlt, nothing useful follows */
+
+#define INSN_NO_REG         0xFF
+
+struct insn
+{
+    uint8_t length;
+    uint8_t kind;           /* INSN_* */
+    uint8_t reg;            /* mov imm64 destination or indirect branch register, INSN_NO_REG for memory */
+    uint8_t rip_relative;   /* memory operand is [rip + disp] */
+    int32_t disp;
+    int64_t imm;            /* branch displacement or the pushed/moved immediate */
+};
+
+uint8_t insn_decode(const uint8_t *code, size_t size, struct insn *insn);
+
+/* destination of a direct branch at address */
+static inline uint64_t
+insn_branch_target(uint64_t address, const struct insn *insn)
+{
+    return address + insn->length + (uint64_t)insn->imm;
+}
+
+#endif
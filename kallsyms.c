@@ -0,0 +1,363 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * kallsyms.c
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "kallsyms.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "symbols.h"
+#include "textindex.h"
+#include "stats.h"
+
+/* the file text and where each line starts, names are terminated in place */
+struct symbol_text
+{
+    char *strings;
+    const uint32_t *lines;
+    uint32_t nr_lines;
+    uint32_t size;
+    uint64_t slide;         /* removed from every address before the sort */
+};
+
+/* local functions */
+static char * read_symbol_file(const char *path, size_t *size, int *mapped);
+static uint32_t * index_lines(const char *text, size_t size, uint32_t *nr_lines);
+static const char * parse_symbol_address(const char *p, const char *eol, uint64_t *address);
+static uint64_t find_text_start(const struct symbol_text *text);
+static uint32_t filter_symbol_lines(const void *context, uint32_t begin, uint32_t end, struct symbol_entry *out);
+static uint64_t find_symbol_address(const struct symbol_index *index, const char *name);
+
+/*
+ * a regular file (System.map, a saved kallsyms) is mapped
+ * procfs files report no size so those are read into a buffer that grows as we go
+ */
+static char *
+read_symbol_file(const char *path, size_t *size, int *mapped)
+{
+    int fd = STATS_SYSCALL(open(path, O_RDONLY));
+    if (fd < 0)
+    {
+        ERROR_MSG("Failed to open %s, %s.", path, strerror(errno));
+        return NULL;
+    }
+    struct stat stat = {0};
+    if (STATS_SYSCALL(fstat(fd, &stat)) == 0 && S_ISREG(stat.st_mode) && stat.st_size > 0)
+    {
+        char *map = STATS_SYSCALL(mmap(0, stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0));
+        STATS_SYSCALL(close(fd));
+        if (map == MAP_FAILED)
+        {
+            ERROR_MSG("mmap of %s failed, %s.", path, strerror(errno));
+            return NULL;
+        }
+        *size = stat.st_size;
+        *mapped = 1;
+        return map;
+    }
+    
+    size_t capacity = 8 * KALLSYMS_READ_SIZE;
+    size_t used = 0;
+    char *buf = malloc(capacity);
+    while (buf != NULL)
+    {
+        if (capacity - used < KALLSYMS_READ_SIZE)
+        {
+            char *bigger = realloc(buf, capacity * 2);
+            if (bigger == NULL)
+            {
+                free(buf);
+                buf = NULL;
+                break;
+            }
+            buf = bigger;
+            capacity *= 2;
+        }
+        ssize_t ret = STATS_SYSCALL(read(fd, buf + used, KALLSYMS_READ_SIZE));
+        if (ret < 0)
+        {
+            ERROR_MSG("Error while reading %s, %s.", path, strerror(errno));
+            free(buf);
+            buf = NULL;
+            break;
+        }
+        if (ret == 0)
+        {
+            break;
+        }
+        used += ret;
+    }
+    STATS_SYSCALL(close(fd));
+    *size = used;
+    *mapped = 0;
+    return buf;
+}
+
+/* one memchr pass for the start of every line, so the lines can be parsed in parallel */
+static uint32_t *
+index_lines(const char *text, size_t size, uint32_t *nr_lines)
+{
+    uint32_t capacity = (uint32_t)(size / 32) + 1;
+    uint32_t *lines = malloc(capacity * sizeof(uint32_t));
+    uint32_t count = 0;
+    const char *p = text;
+    const char *end = text + size;
+    while (lines != NULL && p < end)
+    {
+        if (count == capacity)
+        {
+            uint32_t *bigger = realloc(lines, capacity * 2 * sizeof(uint32_t));
+            if (bigger == NULL)
+            {
+                free(lines);
+                return NULL;
+            }
+            lines = bigger;
+            capacity *= 2;
+        }
+        lines[count++] = (uint32_t)(p - text);
+        const char *eol = memchr(p, '\n', end - p);
+        p = eol != NULL ? eol + 1 : end;
+    }
+    *nr_lines = count;
+    return lines;
+}
+
+/*
+ * the hex address at the start of a line, up to the space before the type
+ * hex digits to value without branches, works for both cases, anything else rejects the line
+ * returns where the address ends or NULL
+ */
+static const char *
+parse_symbol_address(const char *p, const char *eol, uint64_t *address)
+{
+    uint64_t value = 0;
+    uint32_t invalid = 0;
+    const char *q = p;
+    while (q < eol && *q != ' ')
+    {
+        char c = *q;
+        invalid |= !((c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'f'));
+        value = (value << 4) | ((c & 0xF) + 9 * (c >> 6));
+        q++;
+    }
+    if (invalid != 0 || q == p || q - p > 16)
+    {
+        return NULL;
+    }
+    *address = value;
+    return q;
+}
+
+/* _text is in the first few hundred lines, a plain scan is enough before the index exists */
+static uint64_t
+find_text_start(const struct symbol_text *text)
+{
+    for (uint32_t i = 0; i < text->nr_lines; i++)
+    {
+        const char *p = text->strings + text->lines[i];
+        const char *eol = text->strings + (i + 1 < text->nr_lines ? text->lines[i + 1] - 1 : text->size);
+        uint64_t address = 0;
+        const char *q = parse_symbol_address(p, eol, &address);
+        if (q != NULL && eol - q == 8 && memcmp(q, " T _text", 8) == 0)
+        {
+            return address;
+        }
+    }
+    return 0;
+}
+
+/*
+ * "address type name [module]" lines [begin, end), kallsyms and System.map share the format
+ * absolute and undefined symbols and hidden (zero) addresses can't be handlers and are skipped
+ * the slide is removed here so the sort sees the final addresses, the per-cpu symbols that are
+ * below it (their addresses are offsets, not slid) are dropped instead of wrapping around
+ * each name is terminated where its newline was, with the module tab turned into a space,
+ * chunks only touch their own lines so they can run on any thread
+ */
+static uint32_t
+filter_symbol_lines(const void *context, uint32_t begin, uint32_t end, struct symbol_entry *out)
+{
+    const struct symbol_text *text = context;
+    uint32_t count = 0;
+    for (uint32_t i = begin; i < end; i++)
+    {
+        char *p = text->strings + text->lines[i];
+        char *eol = text->strings + (i + 1 < text->nr_lines ? text->lines[i + 1] - 1 : text->size);
+        
+        uint64_t address = 0;
+        char *q = (char*)parse_symbol_address(p, eol, &address);
+        if (q == NULL || eol - q < 4 || q[2] != ' ' || address == 0 || address < text->slide ||
+            q[1] == 'a' || q[1] == 'A' || q[1] == 'U')
+        {
+            continue;
+        }
+        *eol = '\0';
+        char *tab = memchr(q + 3, '\t', eol - (q + 3));
+        if (tab != NULL)
+        {
+            *tab = ' ';
+        }
+        out[count].address = address - text->slide;
+        out[count].name_off = (uint32_t)(q + 3 - text->strings);
+        out[count].reserved = 0;
+        count++;
+    }
+    return count;
+}
+
+static uint64_t
+find_symbol_address(const struct symbol_index *index, const char *name)
+{
+    const struct symbol_entry *entry = symbol_index_find_name(index, name);
+    return entry != NULL ? entry->address : 0;
+}
+
+/*
+ * build the symbol index from /proc/kallsyms or a System.map
+ * the lines are parsed and sorted in parallel chunks by symbol_index_build()
+ * kallsyms addresses are slid, the slide is _text minus its link address and the parser
+ * removes it from every symbol so the index looks like the one from the Mach-O loader
+ * this is the slide of the file, the running kernel's comes from get_linux_kaslr_slide()
+ * the text ranges come from _stext/_etext
+ */
+int
+load_kallsyms(struct config *cfg)
+{
+    size_t size = 0;
+    int mapped = 0;
+    char *file = read_symbol_file(cfg->kernel_filename, &size, &mapped);
+    if (file == NULL)
+    {
+        return -1;
+    }
+    struct symbol_text text = {0};
+    uint32_t *lines = NULL;
+    char *strings = NULL;
+    int ret = -1;
+    if (size < UINT32_MAX && (lines = index_lines(file, size, &text.nr_lines)) != NULL &&
+        symbol_index_init(&cfg->symbols, text.nr_lines, (uint32_t)size + 1, &strings) == 0)
+    {
+        /* the names are used where they are in the copy of the file */
+        memcpy(strings, file, size);
+        strings[size] = '\0';
+        text.strings = strings;
+        text.lines = lines;
+        text.size = (uint32_t)size;
+        uint64_t text_start = find_text_start(&text);
+        text.slide = text_start > LINUX_TEXT_BASE ? text_start - LINUX_TEXT_BASE : 0;
+        ret = symbol_index_build(&cfg->symbols, text.nr_lines, filter_symbol_lines, &text, cfg->nr_threads);
+    }
+    free(lines);
+    if (mapped == 1)
+    {
+        STATS_SYSCALL(munmap(file, size));
+    }
+    else
+    {
+        free(file);
+    }
+    struct symbol_index *index = &cfg->symbols;
+    if (ret == 0 && index->nr_entries == 0)
+    {
+        ERROR_MSG("No usable symbols in %s, are the addresses hidden by kptr_restrict?", cfg->kernel_filename);
+        ret = -1;
+    }
+    if (ret != 0)
+    {
+        symbol_index_free(index);
+        return -1;
+    }
+    
+    uint64_t stext = find_symbol_address(index, "_stext");
+    uint64_t etext = find_symbol_address(index, "_etext");
+    text_index_init(&cfg->text);
+    if (stext != 0 && etext > stext)
+    {
+        text_index_add(&cfg->text, stext, etext - stext);
+    }
+    text_index_finalize(&cfg->text);
+    DEBUG_MSG("Loaded %u symbols from %s, slide 0x%llx.", index->nr_entries, cfg->kernel_filename, (unsigned long long)text.slide);
+    return 0;
+}
+
+/*
+ * the running kernel's slide, whatever file the symbols came from
+ * _text is in the first few hundred lines of /proc/kallsyms so we stop reading there
+ */
+int
+get_linux_kaslr_slide(uint64_t *slide)
+{
+    FILE *fp = fopen(LINUX_KALLSYMS_PATH, "r");
+    if (fp == NULL)
+    {
+        ERROR_MSG("Failed to open %s, %s.", LINUX_KALLSYMS_PATH, strerror(errno));
+        return -1;
+    }
+    char line[512] = {0};
+    uint64_t text_start = 0;
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        char *type = strchr(line, ' ');
+        if (type != NULL && strncmp(type, " T _text\n", 9) == 0)
+        {
+            text_start = strtoull(line, NULL, 16);
+            break;
+        }
+    }
+    fclose(fp);
+    if (text_start == 0)
+    {
+        ERROR_MSG("No _text address in %s, are the addresses hidden by kptr_restrict?", LINUX_KALLSYMS_PATH);
+        return -1;
+    }
+    *slide = text_start > LINUX_TEXT_BASE ? text_start - LINUX_TEXT_BASE : 0;
+    return 0;
+}
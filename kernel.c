@@ -46,20 +46,44 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <string.h>
+#ifdef __APPLE__
 #include <sys/sysctl.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
+#include <ctype.h>
 #include <sys/syscall.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
-#include <mach-o/loader.h>
-#include <mach-o/nlist.h>
-#include <mach/mach_vm.h>
 
 #include "global.h"
+#include "macho.h"
+#include "kallsyms.h"
+#include "vmlinux.h"
+#include "elf64.h"
+#include "symbols.h"
+#include "symcache.h"
+#include "stats.h"
+#include "textindex.h"
 
+/* local functions */
+static int read_file_range(int fd, void *buffer, size_t size, uint64_t offset);
+static int parse_kernel_header(int kernel_fd, const struct stat *stat, struct kernel_symtab *symtab, struct text_index *text);
+static void load_kernel_symbols(struct config *cfg);
+static int get_kernel_file_format(const char *path);
+static int is_symbol_map_line(const char *line, size_t size);
+static uint32_t filter_nlist(const void *context, uint32_t begin, uint32_t end, struct symbol_entry *out);
+
+/* what filter_nlist() works on */
+struct nlist_filter
+{
+    const struct nlist_64 *nlist;
+    uint32_t strsize;
+};
+
+#ifdef __APPLE__
 /*
  * retrieve which kernel type are we running, 32 or 64 bits
  */
@@ -68,9 +92,9 @@ get_kernel_type(void)
 {
     size_t size = 0;
     int8_t ret = 0;
-    sysctlbyname("hw.machine", NULL, &size, NULL, 0);
+    STATS_SYSCALL(sysctlbyname("hw.machine", NULL, &size, NULL, 0));
     char *machine = malloc(size);
-    sysctlbyname("hw.machine", machine, &size, NULL, 0);
+    STATS_SYSCALL(sysctlbyname("hw.machine", machine, &size, NULL, 0));
     
     if (strcmp(machine, "i386") == 0)
     {
@@ -106,9 +130,9 @@ get_kernel_version(void)
     
     mib[0] = CTL_KERN;
     mib[1] = KERN_OSRELEASE;
-    sysctl(mib, 2, NULL, &len, NULL, 0);
+    STATS_SYSCALL(sysctl(mib, 2, NULL, &len, NULL, 0));
     kernelVersion = malloc(len * sizeof(char));
-    sysctl(mib, 2, kernelVersion, &len, NULL, 0);
+    STATS_SYSCALL(sysctl(mib, 2, kernelVersion, &len, NULL, 0));
     
     if (strncmp(kernelVersion, "10.", 3) == 0)
     {
@@ -169,165 +193,444 @@ get_kaslr_slide(size_t *size, uint64_t *slide)
              : "rdi", "rsi", "rdx", "rax"
              );
 }
+#else
+/* there's no running OS X kernel to ask, only offline sources are available */
+int32_t
+get_kernel_type(void)
+{
+    return -1;
+}
+
+int32_t
+get_kernel_version(void)
+{
+    return -1;
+}
+
+void
+get_kaslr_slide(size_t *size, uint64_t *slide)
+{
+    (void)size;
+    *slide = 0;
+}
+#endif
 
-/* warning: caller must always supply the buffer since we are using mach_vm_read_overwrite */
+/* read from whatever memory source was opened, the caller always supplies the buffer */
 kern_return_t
 readkmem(struct config *cfg, void *buffer, mach_vm_address_t target_addr, const int read_size)
 {
-    if (cfg->kernel_port != 0)
+    stats_add(STATS_READKMEM_CALLS, 1);
+    stats_add(STATS_BYTES_READ, read_size);
+    return cfg->source.read(&cfg->source, buffer, target_addr, read_size);
+}
+
+/* readkmem() for reads the caller has a fallback for, the backend doesn't report failures */
+kern_return_t
+readkmem_quiet(struct config *cfg, void *buffer, mach_vm_address_t target_addr, const int read_size)
+{
+    cfg->source.quiet = 1;
+    kern_return_t kr = readkmem(cfg, buffer, target_addr, read_size);
+    cfg->source.quiet = 0;
+    return kr;
+}
+
+/*
+ * zero copy access to kernel memory for sources that support it (file images)
+ * returns NULL if the source can't map the range, use readkmem() then
+ */
+const void *
+mapkmem(struct config *cfg, mach_vm_address_t target_addr, size_t size)
+{
+    if (cfg->source.map == NULL)
+    {
+        return NULL;
+    }
+    return cfg->source.map(&cfg->source, target_addr, size);
+}
+
+kern_return_t
+writekmem(struct config *cfg, void *buffer, mach_vm_address_t target_addr, const int size)
+{
+    if (cfg->source.write == NULL)
+    {
+        ERROR_MSG("Memory source %s doesn't support writes.", cfg->source.name);
+        return KERN_FAILURE;
+    }
+    stats_add(STATS_WRITEKMEM_CALLS, 1);
+    stats_add(STATS_BYTES_WRITTEN, size);
+    return cfg->source.write(&cfg->source, buffer, target_addr, size);
+}
+
+/* pread until everything is read, short reads happen on some filesystems */
+static int
+read_file_range(int fd, void *buffer, size_t size, uint64_t offset)
+{
+    uint8_t *p = buffer;
+    while (size > 0)
     {
-        mach_vm_size_t outsize = 0;
-        kern_return_t kr = mach_vm_read_overwrite(cfg->kernel_port, target_addr, read_size, (mach_vm_address_t)buffer, &outsize);
-        if (kr != KERN_SUCCESS)
+        ssize_t ret = STATS_SYSCALL(pread(fd, p, size, (off_t)offset));
+        if (ret <= 0)
         {
-            ERROR_MSG("mach_vm_read_overwrite failed!");
-            return KERN_FAILURE;
+            return -1;
         }
+        p += ret;
+        offset += ret;
+        size -= ret;
     }
-    else
+    return 0;
+}
+
+/*
+ * read the mach-o header and load commands and extract what we need to find the symbols
+ * every load command is checked against sizeofcmds and the tables against the file size
+ * so a truncated or hostile kernel file can't make us read outside of it
+ * the executable segments (__TEXT, __HIB, ...) go into the text index
+ */
+static int
+parse_kernel_header(int kernel_fd, const struct stat *stat, struct kernel_symtab *symtab, struct text_index *text)
+{
+    struct mach_header_64 mh = {0};
+    if (read_file_range(kernel_fd, &mh, sizeof(mh), 0) != 0)
+    {
+        ERROR_MSG("Can't read mach-o header.");
+        return -1;
+    }
+    /* test if it's a valid mach-o header (or appears to be) */
+    if (mh.magic != MH_MAGIC_64)
+    {
+        ERROR_MSG("Target is not 64 bits only!");
+        return -1;
+    }
+    if (mh.sizeofcmds > (uint64_t)stat->st_size - sizeof(mh))
+    {
+        ERROR_MSG("Load commands are bigger than the file.");
+        return -1;
+    }
+    uint8_t *cmds = malloc(mh.sizeofcmds);
+    if (cmds == NULL || read_file_range(kernel_fd, cmds, mh.sizeofcmds, sizeof(mh)) != 0)
     {
-        if(lseek(cfg->fd_kmem, (off_t)target_addr, SEEK_SET) != (off_t)target_addr)
+        ERROR_MSG("Can't read load commands.");
+        free(cmds);
+        return -1;
+    }
+    
+    int found_symtab = 0;
+    uint64_t linkedit_fileoff = 0, linkedit_filesize = 0;
+    /* iterate over all load cmds and retrieve required info to solve symbols */
+    /* __LINKEDIT location and symbol/string table location */
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < mh.ncmds; i++)
+    {
+        struct load_command *load_cmd = (struct load_command*)(cmds + offset);
+        if (mh.sizeofcmds - offset < sizeof(struct load_command) ||
+            load_cmd->cmdsize < sizeof(struct load_command) ||
+            load_cmd->cmdsize > mh.sizeofcmds - offset)
         {
-            ERROR_MSG("Error in lseek. Are you root?");
-            exit(-1);
+            ERROR_MSG("Load command %u is out of bounds.", i);
+            free(cmds);
+            return -1;
         }
-        if(read(cfg->fd_kmem, buffer, read_size) != read_size)
+        if (load_cmd->cmd == LC_SEGMENT_64 && load_cmd->cmdsize >= sizeof(struct segment_command_64))
         {
-            ERROR_MSG("Error while trying to read from kmem: %s.", strerror(errno));
-            exit(-1);
+            struct segment_command_64 *seg_cmd = (struct segment_command_64*)load_cmd;
+            if (strncmp(seg_cmd->segname, "__LINKEDIT", 16) == 0)
+            {
+                linkedit_fileoff = seg_cmd->fileoff;
+                linkedit_filesize = seg_cmd->filesize;
+            }
+            if ((seg_cmd->initprot & VM_PROT_EXECUTE) != 0)
+            {
+                text_index_add(text, seg_cmd->vmaddr, seg_cmd->vmsize);
+            }
+        }
+        /* table information available at LC_SYMTAB command */
+        else if (load_cmd->cmd == LC_SYMTAB && load_cmd->cmdsize >= sizeof(struct symtab_command))
+        {
+            struct symtab_command *symtab_cmd = (struct symtab_command*)load_cmd;
+            symtab->symoff = symtab_cmd->symoff;
+            symtab->nsyms = symtab_cmd->nsyms;
+            symtab->stroff = symtab_cmd->stroff;
+            symtab->strsize = symtab_cmd->strsize;
+            found_symtab = 1;
+        }
+        else if (load_cmd->cmd == LC_UUID && load_cmd->cmdsize >= sizeof(struct uuid_command))
+        {
+            memcpy(symtab->uuid, ((struct uuid_command*)load_cmd)->uuid, sizeof(symtab->uuid));
+            symtab->has_uuid = 1;
         }
+        offset += load_cmd->cmdsize;
     }
-    return KERN_SUCCESS;
+    free(cmds);
+    text_index_finalize(text);
+    
+    if (found_symtab == 0)
+    {
+        ERROR_MSG("No symbol table found.");
+        return -1;
+    }
+    uint64_t symtab_end = (uint64_t)symtab->symoff + (uint64_t)symtab->nsyms * sizeof(struct nlist_64);
+    uint64_t strtab_end = (uint64_t)symtab->stroff + symtab->strsize;
+    /* the copy of the strings gets a NUL appended, so the size needs room for it */
+    if (symtab_end > (uint64_t)stat->st_size || strtab_end > (uint64_t)stat->st_size || symtab->strsize == UINT32_MAX)
+    {
+        ERROR_MSG("Symbol table is out of bounds.");
+        return -1;
+    }
+    /* both tables belong to __LINKEDIT, anything else isn't a kernel we understand */
+    if (linkedit_filesize != 0 &&
+        (symtab->symoff < linkedit_fileoff || symtab_end > linkedit_fileoff + linkedit_filesize ||
+         symtab->stroff < linkedit_fileoff || strtab_end > linkedit_fileoff + linkedit_filesize))
+    {
+        ERROR_MSG("Symbol table is outside __LINKEDIT.");
+        return -1;
+    }
+    return 0;
 }
 
-void
-writekmem(int fd, void *buffer, off_t offset, const int size)
+/* we only want symbols defined in some section, debug and undefined entries can't be handlers */
+static uint32_t
+filter_nlist(const void *context, uint32_t begin, uint32_t end, struct symbol_entry *out)
+{
+    const struct nlist_filter *filter = context;
+    const struct nlist_64 *nlist = filter->nlist;
+    uint32_t count = 0;
+    for (uint32_t i = begin; i < end; i++)
+    {
+        if ( (nlist[i].n_type & N_STAB) != 0 ||
+             (nlist[i].n_type & N_TYPE) != N_SECT ||
+             nlist[i].n_value == 0 ||
+             nlist[i].n_un.n_strx >= filter->strsize )
+        {
+            continue;
+        }
+        out[count].address = nlist[i].n_value;
+        out[count].name_off = nlist[i].n_un.n_strx;
+        out[count].reserved = 0;
+        count++;
+    }
+    return count;
+}
+
+/* "address type name", the type is a single letter and the name runs to the end of the line */
+static int
+is_symbol_map_line(const char *line, size_t size)
+{
+    size_t i = 0;
+    while (i < size && i < 16 && isxdigit((unsigned char)line[i]))
+    {
+        i++;
+    }
+    if (i == 0 || i + 3 >= size || line[i] != ' ' || isalpha((unsigned char)line[i + 1]) == 0 || line[i + 2] != ' ')
+    {
+        return 0;
+    }
+    i += 3;
+    size_t name = i;
+    while (i < size && line[i] != '\n' && line[i] != '\t' && isgraph((unsigned char)line[i]))
+    {
+        i++;
+    }
+    /* a line cut by the probe size is fine, anything else must end there */
+    return i > name && (i == size || line[i] == '\n' || line[i] == '\t');
+}
+
+/* the binaries are told by their magic, a symbol map by the format of its first line */
+static int
+get_kernel_file_format(const char *path)
 {
-    if(lseek(fd, offset, SEEK_SET) != offset)
+    union
+    {
+        uint32_t magic;
+        char ident[SELFMAG];
+        char text[KERNEL_FILE_PROBE_SIZE];
+    } header = {0};
+    int fd = STATS_SYSCALL(open(path, O_RDONLY));
+    if (fd < 0)
+    {
+        /* let the Mach-O loader report it, it's the default */
+        return KERNEL_FILE_MACHO;
+    }
+    ssize_t ret = STATS_SYSCALL(read(fd, &header, sizeof(header)));
+    STATS_SYSCALL(close(fd));
+    if (ret < (ssize_t)sizeof(uint32_t))
+    {
+        return KERNEL_FILE_UNKNOWN;
+    }
+    if (header.magic == MH_MAGIC_64)
+    {
+        return KERNEL_FILE_MACHO;
+    }
+    if (header.magic == FAT_MAGIC || header.magic == FAT_CIGAM)
     {
-        ERROR_MSG("Error in lseek. Are you root?");
-        exit(-1);
+        return KERNEL_FILE_FAT;
     }
-    if(write(fd, buffer, size) != size)
+    if (memcmp(header.ident, ELFMAG, SELFMAG) == 0)
     {
-        ERROR_MSG("Error while trying to write to kmem: %s.", strerror(errno));
-        exit(-1);
+        return KERNEL_FILE_ELF;
     }
+    if (is_symbol_map_line(header.text, (size_t)ret))
+    {
+        return KERNEL_FILE_SYMBOL_MAP;
+    }
+    return KERNEL_FILE_UNKNOWN;
 }
 
+/*
+ * build the symbol index from the kernel file
+ * only the load commands, the nlist array and the string table are read, the index entries
+ * and a copy of the strings live in a single allocation released by release_kernel_symbols()
+ */
 void
 retrieve_kernel_symbols(struct config *cfg)
 {
-    int kernel_fd = open("/mach_kernel", O_RDONLY);
+    uint64_t start = stats_begin();
+    switch (get_kernel_file_format(cfg->kernel_filename))
+    {
+        case KERNEL_FILE_SYMBOL_MAP:
+            load_kallsyms(cfg);
+            break;
+        case KERNEL_FILE_ELF:
+            load_vmlinux_symbols(cfg);
+            break;
+        case KERNEL_FILE_FAT:
+            ERROR_MSG("%s is a universal binary, extract the x86_64 kernel with lipo -thin x86_64.", cfg->kernel_filename);
+            break;
+        case KERNEL_FILE_UNKNOWN:
+            ERROR_MSG("%s is not a Mach-O kernel, a vmlinux or a symbol map.", cfg->kernel_filename);
+            break;
+        default:
+            load_kernel_symbols(cfg);
+            break;
+    }
+    stats_add(STATS_SYMBOLS_LOADED, cfg->symbols.nr_entries);
+    stats_end(STATS_PHASE_SYMBOLS, start);
+}
+
+static void
+load_kernel_symbols(struct config *cfg)
+{
+    int kernel_fd = STATS_SYSCALL(open(cfg->kernel_filename, O_RDONLY));
     if (kernel_fd < 0)
     {
-        ERROR_MSG("Failed to open /mach_kernel, %s.", strerror(errno));
+        ERROR_MSG("Failed to open %s, %s.", cfg->kernel_filename, strerror(errno));
         return;
     }
     struct stat stat = {0};
-    if ( fstat(kernel_fd, &stat) < 0 )
+    if ( STATS_SYSCALL(fstat(kernel_fd, &stat)) < 0 )
     {
-        ERROR_MSG("Can't fstat /mach_kernel, %s.", strerror(errno));
-        close(kernel_fd);
+        ERROR_MSG("Can't fstat %s, %s.", cfg->kernel_filename, strerror(errno));
+        STATS_SYSCALL(close(kernel_fd));
         return;
     }
-    uint8_t *kernel_buf = NULL;
-    if ( (kernel_buf = mmap(0, stat.st_size, PROT_READ, MAP_SHARED, kernel_fd, 0)) == MAP_FAILED )
+    
+    struct kernel_symtab symtab = {0};
+    text_index_init(&cfg->text);
+    if (parse_kernel_header(kernel_fd, &stat, &symtab, &cfg->text) != 0)
     {
-        ERROR_MSG("mmap of /mach_kernel failed, %s.", strerror(errno));
-        close(kernel_fd);
+        ERROR_MSG("Can't find symbols in %s.", cfg->kernel_filename);
+        STATS_SYSCALL(close(kernel_fd));
         return;
     }
     
-    /* process the kernel mach-o header to find where symbols are */
-    uint64_t linkedit_fileoff = 0;
-    uint64_t linkedit_size = 0;
-    uint32_t symboltable_fileoff = 0;
-    uint32_t symboltable_nr_symbols = 0;
-    uint32_t stringtable_fileoff = 0;
-    uint32_t stringtable_size = 0;
-
-    struct mach_header_64 *mh = (struct mach_header_64*)kernel_buf;
-    /* test if it's a valid mach-o header (or appears to be) */
-    if (mh->magic != MH_MAGIC_64)
+    /* a valid cache for this kernel saves us from processing all the symbols */
+    if (symtab.has_uuid && load_symbol_cache(&cfg->symbols, symtab.uuid, &stat) == 0)
     {
-        ERROR_MSG("Target /mach_kernel is not 64 bits only!");
+        stats_add(STATS_SYMBOL_CACHE_HITS, 1);
+        STATS_SYSCALL(close(kernel_fd));
         return;
     }
     
-    struct load_command *load_cmd = NULL;
-    /* point to the first load command */
-    char *load_cmd_addr = (char*)kernel_buf + sizeof(struct mach_header_64);
-    /* iterate over all load cmds and retrieve required info to solve symbols */
-    /* __LINKEDIT location and symbol/string table location */
-    for (uint32_t i = 0; i < mh->ncmds; i++)
+    char *strings = NULL;
+    if (symbol_index_init(&cfg->symbols, symtab.nsyms, symtab.strsize + 1, &strings) != 0)
     {
-        load_cmd = (struct load_command*)load_cmd_addr;
-        if (load_cmd->cmd == LC_SEGMENT_64)
-        {
-            struct segment_command_64 *seg_cmd = (struct segment_command_64*)load_cmd;
-            if (strncmp(seg_cmd->segname, "__LINKEDIT", 16) == 0)
-            {
-                linkedit_fileoff = seg_cmd->fileoff;
-                linkedit_size    = seg_cmd->filesize;
-            }
-        }
-        /* table information available at LC_SYMTAB command */
-        else if (load_cmd->cmd == LC_SYMTAB)
-        {
-            struct symtab_command *symtab_cmd = (struct symtab_command*)load_cmd;
-            symboltable_fileoff    = symtab_cmd->symoff;
-            symboltable_nr_symbols = symtab_cmd->nsyms;
-            stringtable_fileoff    = symtab_cmd->stroff;
-            stringtable_size       = symtab_cmd->strsize;
-        }
-        load_cmd_addr += load_cmd->cmdsize;
+        STATS_SYSCALL(close(kernel_fd));
+        return;
     }
+    if (read_file_range(kernel_fd, strings, symtab.strsize, symtab.stroff) != 0)
+    {
+        ERROR_MSG("Can't read string table from %s.", cfg->kernel_filename);
+        symbol_index_free(&cfg->symbols);
+        STATS_SYSCALL(close(kernel_fd));
+        return;
+    }
+    /* the table should end with a NUL but the last name is safe even if it doesn't */
+    strings[symtab.strsize] = '\0';
     
-    /* pointer to __LINKEDIT offset */
-    char *linkedit_buf = (char*)kernel_buf + linkedit_fileoff;
+    /* the nlist array is only needed while filtering, map just that range */
+    long page_size = sysconf(_SC_PAGESIZE);
+    uint64_t map_start = symtab.symoff & ~((uint64_t)page_size - 1);
+    size_t map_size = (size_t)(symtab.symoff - map_start) + (size_t)symtab.nsyms * sizeof(struct nlist_64);
+    uint8_t *map = NULL;
+    if (symtab.nsyms > 0 &&
+        (map = STATS_SYSCALL(mmap(0, map_size, PROT_READ, MAP_PRIVATE, kernel_fd, (off_t)map_start))) == MAP_FAILED)
+    {
+        ERROR_MSG("mmap of %s symbol table failed, %s.", cfg->kernel_filename, strerror(errno));
+        symbol_index_free(&cfg->symbols);
+        STATS_SYSCALL(close(kernel_fd));
+        return;
+    }
+    STATS_SYSCALL(close(kernel_fd));
     
-    /* retrieve all kernel symbols */
-    SLIST_INIT(&cfg->symbols_head);
-    struct nlist_64 *nlist = NULL;
+    /* filtered and sorted in parallel chunks */
+    struct nlist_filter filter = { (const struct nlist_64*)(map + (symtab.symoff - map_start)), symtab.strsize };
+    int ret = symbol_index_build(&cfg->symbols, symtab.nsyms, filter_nlist, &filter, cfg->nr_threads);
+    if (map != NULL)
+    {
+        STATS_SYSCALL(munmap(map, map_size));
+    }
+    if (ret != 0)
+    {
+        symbol_index_free(&cfg->symbols);
+        return;
+    }
+    DEBUG_MSG("Loaded %u kernel symbols.", cfg->symbols.nr_entries);
     
-    for (uint32_t i = 0; i < symboltable_nr_symbols; i++)
-    {
-        /* symbols and strings offsets into LINKEDIT */
-        mach_vm_address_t symbol_off = symboltable_fileoff - linkedit_fileoff;
-        mach_vm_address_t string_off = stringtable_fileoff - linkedit_fileoff;
-        
-        nlist = (struct nlist_64*)(linkedit_buf + symbol_off + i * sizeof(struct nlist_64));
-        char *symbol_string = (linkedit_buf + string_off + nlist->n_un.n_strx);
-        /* add symbols to linked list so we can search them later */
-        struct symbols *new = malloc(sizeof(struct symbols));
-        if (new != NULL)
-        {
-            new->address = nlist->n_value;
-            new->name = symbol_string;
-            SLIST_INSERT_HEAD(&cfg->symbols_head, new, entries);
-        }
+    /* save the cache for next runs */
+    if (symtab.has_uuid)
+    {
+        save_symbol_cache(&cfg->symbols, symtab.uuid, &stat);
     }
 }
 
 void
+release_kernel_symbols(struct config *cfg)
+{
+    symbol_index_free(&cfg->symbols);
+}
+
+/*
+ * resolve a stub address to symbol or symbol+offset if it points inside a function
+ * a handler pointing into the middle of something is usually a good sign of a hook
+ * returns -1 and "can't resolve" in name if there's no symbol below the address or the
+ * address is outside the kernel text
+ */
+int
 resolve_symbol(struct config *cfg, mach_vm_address_t stub_addr, char *name, size_t name_size)
 {
-    int found = 0;
-    struct symbols *el = NULL;
-    SLIST_FOREACH(el, &cfg->symbols_head, entries)
+    /* the addresses we read from kernel memory are ASLRed so we need to fix it */
+    mach_vm_address_t address = stub_addr - cfg->kaslr_slide;
+    /* a kext or heap address is not the last kernel function plus a huge offset */
+    const struct symbol_entry *symbol = NULL;
+    if (cfg->text.nr_ranges == 0 || text_index_contains(&cfg->text, address))
     {
-        /* the addresses we read from kernel memory are ASLRed so we need to fix it */
-        if (stub_addr - cfg->kaslr_slide == el->address)
-        {
-            strncpy(name, el->name, name_size);
-            found = 1;
-            break;
-        }
+        symbol = symbol_index_lookup(&cfg->symbols, address);
     }
+    stats_add(STATS_SYMBOL_LOOKUPS, 1);
     
-    if (found == 0)
+    if (symbol == NULL)
+    {
+        snprintf(name, name_size, "can't resolve");
+        return -1;
+    }
+    
+    const char *symbol_name = cfg->symbols.strings + symbol->name_off;
+    if (symbol->address == address)
+    {
+        snprintf(name, name_size, "%s", symbol_name);
+    }
+    else
     {
-        strncpy(name, "can't resolve", name_size);
+        snprintf(name, name_size, "%s+0x%llx", symbol_name, (unsigned long long)(address - symbol->address));
     }
+    return 0;
 }
@@ -46,16 +46,38 @@
 
 #include <sys/types.h>
 #include <stdint.h>
-#include <mach/mach.h>
 #include "global.h"
 
+/* kinds of kernel files we take symbols from */
+#define KERNEL_FILE_MACHO       0
+#define KERNEL_FILE_SYMBOL_MAP  1   /* nm style text, /proc/kallsyms or System.map */
+#define KERNEL_FILE_ELF         2   /* Linux vmlinux with a symbol table */
+#define KERNEL_FILE_FAT         3   /* universal Mach-O, we only read thin kernels */
+#define KERNEL_FILE_UNKNOWN     4
+
+#define KERNEL_FILE_PROBE_SIZE  256 /* enough for the first line of a symbol map */
+
+/* where the symbols are inside the kernel file */
+struct kernel_symtab
+{
+    uint32_t symoff;
+    uint32_t nsyms;
+    uint32_t stroff;
+    uint32_t strsize;
+    uint8_t uuid[16];
+    int has_uuid;
+};
+
 /* exported functions */
 int32_t get_kernel_type (void);
 int32_t get_kernel_version(void);
 void get_kaslr_slide(size_t *size, uint64_t *slide);
 kern_return_t readkmem(struct config *cfg, void *buffer, mach_vm_address_t target_addr, const int read_size);
-void writekmem(int fd, void *buffer, off_t offset, const int size);
+kern_return_t readkmem_quiet(struct config *cfg, void *buffer, mach_vm_address_t target_addr, const int read_size);
+const void * mapkmem(struct config *cfg, mach_vm_address_t target_addr, size_t size);
+kern_return_t writekmem(struct config *cfg, void *buffer, mach_vm_address_t target_addr, const int size);
 void retrieve_kernel_symbols(struct config *cfg);
-void resolve_symbol(struct config *cfg, mach_vm_address_t stub_addr, char *name, size_t name_size);
+void release_kernel_symbols(struct config *cfg);
+int resolve_symbol(struct config *cfg, mach_vm_address_t stub_addr, char *name, size_t name_size);
 
 #endif
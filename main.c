@@ -56,14 +56,25 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <sys/types.h>
+#include <string.h>
 #include <fcntl.h>
-#include <mach/processor_set.h>
-#include <mach/mach_vm.h>
 
 #include "global.h"
 #include "kernel.h"
 #include "idt.h"
+#include "memsource.h"
+#include "watch.h"
+#include "diff.h"
+#include "percpu.h"
+#include "output.h"
+#include "fleet.h"
+#include "stats.h"
+#include "checkidt.h"
+#include "syscalls.h"
+#include "history.h"
+#include "trampoline.h"
 
 #define VERSION "2.0"
 
@@ -80,6 +91,25 @@ usage(void)
     fprintf(stderr,"       -R        restore IDT\n");
     fprintf(stderr,"       -i file   input filename to compare or read\n");
     fprintf(stderr,"       -s        resolve symbols\n");
+    fprintf(stderr,"       -k file   kernel, vmlinux or System.map to resolve symbols from (default /mach_kernel, /proc/kallsyms on Linux)\n");
+    fprintf(stderr,"       -m file   use a kernel memory image instead of the running kernel (flat dump or ELF core)\n");
+    fprintf(stderr,"       -b addr   kernel address where the memory image starts\n");
+    fprintf(stderr,"       -d addr   IDT address inside the memory image (default image start)\n");
+    fprintf(stderr,"       -S slide  kaslr slide of the memory image\n");
+    fprintf(stderr,"       --watch seconds  rescan the IDT every interval until interrupted\n");
+    fprintf(stderr,"                        against the -i archive or the first scan\n");
+    fprintf(stderr,"       --ignore-slide    compare against an archive from another boot, handlers are rebased to the current KASLR slide\n");
+    fprintf(stderr,"       --diff-fields list  descriptor fields to compare: offset,selector,ist,flags (default all)\n");
+    fprintf(stderr,"       --percpu          capture the IDT on every cpu and report the differences\n");
+    fprintf(stderr,"       --format fmt      output format: table (default), jsonl or bin\n");
+    fprintf(stderr,"       --fleet dir       cluster a directory of archives and diff the outliers\n");
+    fprintf(stderr,"       --threads n       worker threads for batch work (default one per cpu)\n");
+    fprintf(stderr,"       --text-check      verify every handler points into the kernel text segments of -k\n");
+    fprintf(stderr,"       --trampolines     follow the first instructions of every handler and report branches out of kernel text, needs -k\n");
+    fprintf(stderr,"       --syscalls        check sysent and mach_trap_table too (with -C and -c as well), needs -k\n");
+    fprintf(stderr,"       --history file    append the IDT to a history file (with -c and --watch)\n");
+    fprintf(stderr,"                         or query it: summary, --at time, --entry n [--from time] [--to time]\n");
+    fprintf(stderr,"       --stats[=fmt]     print phase timings and counters to stderr: text (default), kv or json\n");
     exit(1);
 }
 
@@ -97,19 +127,42 @@ header(void)
     OUTPUT_MSG("   -----------------------------------------------------");
 }
 
-int
-main(int argc, char ** argv)
+static void
+finish_stats(struct config *cfg, uint64_t start)
 {
-    int option = 0;
-    struct config cfg = {0};
-
-    header();
-    if (argc < 2)
+    stats_end(STATS_PHASE_TOTAL, start);
+    if (cfg->stats == 1)
     {
-        usage();
+        print_stats(cfg->stats_format);
     }
-        
-    while( (option=getopt(argc,argv,"ha:Aco:Ci:rRs")) != -1 )
+}
+
+/* fill cfg from the command line, -1 on an invalid option */
+static int
+parse_options(struct config *cfg, int argc, char **argv)
+{
+    int option = 0;
+    static struct option long_options[] =
+    {
+        { "watch", required_argument, NULL, 'W' },
+        { "diff-fields", required_argument, NULL, 'F' },
+        { "percpu", no_argument, NULL, 'P' },
+        { "format", required_argument, NULL, 'O' },
+        { "fleet", required_argument, NULL, 'L' },
+        { "threads", required_argument, NULL, 'T' },
+        { "stats", optional_argument, NULL, 'X' },
+        { "text-check", no_argument, NULL, 'x' },
+        { "trampolines", no_argument, NULL, 'J' },
+        { "syscalls", no_argument, NULL, 'y' },
+        { "ignore-slide", no_argument, NULL, 'K' },
+        { "history", required_argument, NULL, 'H' },
+        { "at", required_argument, NULL, 'Y' },
+        { "entry", required_argument, NULL, 'E' },
+        { "from", required_argument, NULL, 'G' },
+        { "to", required_argument, NULL, 'U' },
+        { NULL, 0, NULL, 0 }
+    };
+    while( (option=getopt_long(argc,argv,"ha:Aco:Ci:rRsk:m:b:d:S:", long_options, NULL)) != -1 )
     {
         switch(option)
         {
@@ -117,19 +170,19 @@ main(int argc, char ** argv)
                 usage();
                 exit(1);
             case 'a':
-                cfg.interrupt = atoi(optarg);
+                cfg->interrupt = atoi(optarg);
                 break;
             case 'A': 
-                cfg.show_all_descriptors = 1;
+                cfg->show_all_descriptors = 1;
                 break;
             case 'c': 
-                cfg.create_file_archive = 1;
+                cfg->create_file_archive = 1;
                 break;
             case 'r': 
-                cfg.read_file_archive = 1;
+                cfg->read_file_archive = 1;
                 break;
             case 'R': 
-                cfg.restore_idt = 1;
+                cfg->restore_idt = 1;
                 break;
             case 'o':
                 if(strlen(optarg) > MAXPATHLEN - 1)
@@ -137,10 +190,10 @@ main(int argc, char ** argv)
                     ERROR_MSG("File name too long.");
                     return -1;
                 }
-                strncpy(cfg.out_filename, optarg, sizeof(cfg.out_filename));
+                strncpy(cfg->out_filename, optarg, sizeof(cfg->out_filename));
                 break;
             case 'C': 
-                cfg.compare_idt = 1;
+                cfg->compare_idt = 1;
                 break;
             case 'i': 
                 if(strlen(optarg) > MAXPATHLEN - 1)
@@ -148,105 +201,268 @@ main(int argc, char ** argv)
                     ERROR_MSG("File name too long.");
                     return -1;
                 }
-                strncpy(cfg.in_filename, optarg, sizeof(cfg.in_filename));
+                strncpy(cfg->in_filename, optarg, sizeof(cfg->in_filename));
                 break;
             case 's': 
-                cfg.resolve = 1;
+                cfg->resolve = 1;
+                break;
+            case 'k':
+                if(strlen(optarg) > MAXPATHLEN - 1)
+                {
+                    ERROR_MSG("File name too long.");
+                    return -1;
+                }
+                strncpy(cfg->kernel_filename, optarg, sizeof(cfg->kernel_filename));
+                break;
+            case 'm':
+                if(strlen(optarg) > MAXPATHLEN - 1)
+                {
+                    ERROR_MSG("File name too long.");
+                    return -1;
+                }
+                strncpy(cfg->image_filename, optarg, sizeof(cfg->image_filename));
+                cfg->offline = 1;
+                break;
+            case 'b':
+                cfg->image_base = strtoull(optarg, NULL, 0);
+                break;
+            case 'd':
+                cfg->idt_addr = strtoull(optarg, NULL, 0);
+                break;
+            case 'S':
+                cfg->kaslr_slide = strtoull(optarg, NULL, 0);
+                break;
+            case 'W':
+                cfg->watch = 1;
+                cfg->watch_interval = strtod(optarg, NULL);
+                if (cfg->watch_interval <= 0)
+                {
+                    ERROR_MSG("Invalid watch interval.");
+                    return -1;
+                }
+                break;
+            case 'O':
+                if (parse_output_format(optarg, &cfg->output_format) != 0)
+                {
+                    return -1;
+                }
+                break;
+            case 'L':
+                if(strlen(optarg) > MAXPATHLEN - 1)
+                {
+                    ERROR_MSG("Directory name too long.");
+                    return -1;
+                }
+                strncpy(cfg->fleet_dir, optarg, sizeof(cfg->fleet_dir));
+                cfg->fleet = 1;
+                break;
+            case 'X':
+                if (parse_stats_format(optarg, &cfg->stats_format) != 0)
+                {
+                    return -1;
+                }
+                cfg->stats = 1;
+                break;
+            case 'y':
+                cfg->syscalls = 1;
+                break;
+            case 'H':
+                if(strlen(optarg) > MAXPATHLEN - 1)
+                {
+                    ERROR_MSG("File name too long.");
+                    return -1;
+                }
+                strncpy(cfg->history_filename, optarg, sizeof(cfg->history_filename));
+                cfg->history = 1;
+                break;
+            case 'Y':
+                cfg->history_at = strtoll(optarg, NULL, 0);
+                cfg->history_at_set = 1;
+                break;
+            case 'E':
+                cfg->history_entry = (int)strtol(optarg, NULL, 0);
+                if (cfg->history_entry < 0 || cfg->history_entry >= IDT_MAX_ENTRIES)
+                {
+                    ERROR_MSG("Invalid IDT entry.");
+                    return -1;
+                }
+                break;
+            case 'G':
+                cfg->history_from = strtoll(optarg, NULL, 0);
+                break;
+            case 'U':
+                cfg->history_to = strtoll(optarg, NULL, 0);
+                break;
+            case 'x':
+                cfg->text_check = 1;
+                break;
+            case 'J':
+                cfg->trampolines = 1;
+                break;
+            case 'K':
+                cfg->ignore_slide = 1;
+                break;
+            case 'T':
+                cfg->nr_threads = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'P':
+                cfg->percpu = 1;
+                break;
+            case 'F':
+                if (parse_diff_fields(optarg, &cfg->diff_fields) != 0)
+                {
+                    return -1;
+                }
                 break;
         }
     }
-    OUTPUT_MSG("");
+    return 0;
+}
+
+/* everything after the options, the caller releases the context and prints the stats */
+static int
+run_checkidt(struct checkidt_context *ctx)
+{
+    struct config *cfg = &ctx->cfg;
     
-    if (getuid() != 0)
+    /* keep stdout clean for the machine readable formats */
+    if (cfg->output_format == OUTPUT_FORMAT_TABLE)
     {
-        ERROR_MSG("This program needs to be run as root!");
-        return -1;
+        header();
+        OUTPUT_MSG("");
     }
     
-    cfg.kernel_type = get_kernel_type();
-    if (cfg.kernel_type == -1)
+    /* batch analysis works on archives only, no kernel needed */
+    if (cfg->fleet == 1)
     {
-        ERROR_MSG("Unable to retrieve kernel type.");
-        return -1;
+        return analyze_fleet(cfg);
+    }
+    /* history queries only read the history file */
+    if (cfg->history == 1 && cfg->create_file_archive == 0 && cfg->watch == 0)
+    {
+        return show_idt_history(cfg);
+    }
+    
+    if (cfg->offline == 1)
+    {
+        if (checkidt_open_image(ctx, cfg->image_filename, cfg->image_base, cfg->idt_addr, cfg->kaslr_slide) != 0)
+        {
+            return -1;
+        }
     }
-    else if (cfg.kernel_type == X86)
+    else if (checkidt_open_live(ctx) != 0)
     {
-        ERROR_MSG("32 bits kernels not supported.");
         return -1;
     }
     
-    cfg.idt_addr = get_addr_idt(cfg.kernel_type);
-    cfg.idt_size = get_size_idt();
-    cfg.idt_entries = cfg.idt_size / sizeof(struct descriptor_idt);
-    /* we need to populate the size variable else syscall fails */
-    cfg.kaslr_size = sizeof(cfg.kaslr_size);
-    get_kaslr_slide(&cfg.kaslr_size, &cfg.kaslr_slide);
+    if (cfg->output_format == OUTPUT_FORMAT_TABLE)
+    {
+        OUTPUT_MSG("[INFO] Kaslr slide is 0x%llx", cfg->kaslr_slide);
+        OUTPUT_MSG("[INFO] IDT base address is: 0x%llx", cfg->idt_addr);
+        OUTPUT_MSG("[INFO] IDT size: 0x%x\n", cfg->idt_size);
+    }
     
-    OUTPUT_MSG("[INFO] Kaslr slide is 0x%llx", cfg.kaslr_slide);
-    OUTPUT_MSG("[INFO] IDT base address is: 0x%llx", cfg.idt_addr);
-    OUTPUT_MSG("[INFO] IDT size: 0x%x\n", cfg.idt_size);
-
-    /* test if we can read kernel memory using processor_set_tasks() vulnerability */
-    /* vulnerability presented at BlackHat Asia 2014 by Ming-chieh Pan, Sung-ting Tsai. */
-    /* also described in Mac OS X and iOS Internals, page 387 */
-    host_t host_port = mach_host_self();
-    mach_port_t proc_set_default = 0;
-    mach_port_t proc_set_default_control = 0;
-    task_array_t all_tasks = NULL;
-    mach_msg_type_number_t all_tasks_cnt = 0;
-    kern_return_t kr = 0;
-    int valid_kernel_port = 0;
+    /* the text ranges come from the same load commands as the symbols */
+    if (cfg->resolve == 1 || cfg->text_check == 1 || cfg->trampolines == 1 || cfg->syscalls == 1)
+    {
+        checkidt_load_symbols(ctx, NULL);
+    }
     
-    kr = processor_set_default(host_port, &proc_set_default);
-    if (kr == KERN_SUCCESS)
+    int ret = 0;
+    if (cfg->percpu == 1)
     {
-        kr = host_processor_set_priv(host_port, proc_set_default, &proc_set_default_control);
-        if (kr == KERN_SUCCESS)
+        if (cfg->offline == 1)
         {
-            kr = processor_set_tasks(proc_set_default_control, &all_tasks, &all_tasks_cnt);
-            if (kr == KERN_SUCCESS)
-            {
-                DEBUG_MSG("Found valid kernel port using processor_set_tasks() vulnerability!");
-                cfg.kernel_port = all_tasks[0];
-                valid_kernel_port = 1;
-            }
+            ERROR_MSG("Per cpu capture needs a running kernel.");
+            return -1;
         }
+        ret |= check_percpu_idt(cfg);
     }
-    /* if we can't use the vulnerability then try /dev/kmem */
-    if (valid_kernel_port == 0)
+    if (cfg->watch == 1)
     {
-        if( (cfg.fd_kmem = open("/dev/kmem",O_RDWR)) == -1 )
+        if (cfg->trampolines == 1 && cfg->text.nr_ranges == 0)
         {
-            ERROR_MSG("Error while opening /dev/kmem. Is /dev/kmem enabled?");
-            ERROR_MSG("Verify that /Library/Preferences/SystemConfiguration/com.apple.Boot.plist has kmem=1 parameter configured.");
+            ERROR_MSG("No kernel text ranges, they are read from the kernel file with -k.");
             return -1;
         }
+        ret |= watch_idt(cfg);
+        return ret;
     }
     
-    if (cfg.resolve == 1)
+    if(cfg->interrupt >= 0 || cfg->show_all_descriptors == 1)
     {
-        retrieve_kernel_symbols(&cfg);
+        show_idt_info(cfg);
     }
-    
-    if(cfg.interrupt >= 0 || cfg.show_all_descriptors == 1)
+    if(cfg->create_file_archive == 1)
     {
-        show_idt_info(&cfg);
+        uint64_t phase = stats_begin();
+        uint64_t nested = stats_nested_ns();
+        if (cfg->history == 1)
+        {
+            ret |= append_idt_history(cfg);
+        }
+        if (cfg->history == 0 || cfg->out_filename[0] != '\0')
+        {
+            ret |= create_idt_archive(cfg);
+        }
+        stats_end_outer(STATS_PHASE_ARCHIVE, phase, nested);
     }
-    if(cfg.create_file_archive == 1)
+    if(cfg->read_file_archive == 1)
     {
-        create_idt_archive(&cfg);
+        uint64_t phase = stats_begin();
+        uint64_t nested = stats_nested_ns();
+        ret |= read_idt_archive(cfg);
+        stats_end_outer(STATS_PHASE_ARCHIVE, phase, nested);
     }
-    if(cfg.read_file_archive == 1)
+    if(cfg->text_check == 1)
     {
-        read_idt_archive(&cfg);
+        ret |= check_idt_text_ranges(cfg);
     }
-    if(cfg.compare_idt == 1)
+    if(cfg->trampolines == 1)
     {
-        compare_idt(&cfg);
+        uint64_t phase = stats_begin();
+        uint64_t nested = stats_nested_ns();
+        ret |= check_idt_trampolines(cfg);
+        stats_end_outer(STATS_PHASE_TRAMPOLINES, phase, nested);
     }
-    if(cfg.restore_idt == 1)
+    if(cfg->compare_idt == 1 || cfg->restore_idt == 1)
     {
-        compare_idt(&cfg);
+        uint64_t phase = stats_begin();
+        uint64_t nested = stats_nested_ns();
+        ret |= compare_idt(cfg);
+        stats_end_outer(STATS_PHASE_COMPARE, phase, nested);
     }
-    return 0;
+    if(cfg->syscalls == 1)
+    {
+        uint64_t phase = stats_begin();
+        uint64_t nested = stats_nested_ns();
+        ret |= check_syscall_tables(cfg);
+        stats_end_outer(STATS_PHASE_SYSCALLS, phase, nested);
+    }
+    return ret;
+}
+
+int
+main(int argc, char ** argv)
+{
+    struct checkidt_context ctx;
+    struct config *cfg = &ctx.cfg;
+    uint64_t start = stats_begin();
+    checkidt_init(&ctx);
+
+    if (argc < 2)
+    {
+        header();
+        usage();
+    }
+    
+    /* every path goes through here so --stats reports failures too */
+    int ret = parse_options(cfg, argc, argv);
+    if (ret == 0)
+    {
+        ret = run_checkidt(&ctx);
+    }
+    checkidt_close(&ctx);
+    finish_stats(cfg, start);
+    return ret;
 }
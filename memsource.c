@@ -0,0 +1,441 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * memsource.c
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "memsource.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#ifdef __APPLE__
+#include <mach/mach_vm.h>
+#endif
+
+#include "stats.h"
+#include "elf64.h"
+
+/* read failures are left to the caller while it probes with readkmem_quiet() */
+#define READ_ERROR_MSG(source, fmt, ...) do { if ((source)->quiet == 0) ERROR_MSG(fmt, ## __VA_ARGS__); } while (0)
+
+/* local functions */
+static kern_return_t kmem_read(struct memsource *source, void *buffer, mach_vm_address_t address, size_t size);
+static kern_return_t kmem_write(struct memsource *source, const void *buffer, mach_vm_address_t address, size_t size);
+static void kmem_close(struct memsource *source);
+static kern_return_t file_read(struct memsource *source, void *buffer, mach_vm_address_t address, size_t size);
+static const void * file_map(struct memsource *source, mach_vm_address_t address, size_t size);
+static void file_close(struct memsource *source);
+static int compare_core_segments(const void *a, const void *b);
+static kern_return_t core_read(struct memsource *source, void *buffer, mach_vm_address_t address, size_t size);
+static void core_close(struct memsource *source);
+static void read_core_kaslr_offset(struct memsource *source, const Elf64_Phdr *note);
+
+/* Mach kernel port source */
+
+#ifdef __APPLE__
+/* warning: caller must always supply the buffer since we are using mach_vm_read_overwrite */
+static kern_return_t
+mach_read(struct memsource *source, void *buffer, mach_vm_address_t address, size_t size)
+{
+    mach_vm_size_t outsize = 0;
+    kern_return_t kr = STATS_SYSCALL(mach_vm_read_overwrite(source->port, address, size, (mach_vm_address_t)buffer, &outsize));
+    if (kr != KERN_SUCCESS || outsize != size)
+    {
+        READ_ERROR_MSG(source, "mach_vm_read_overwrite failed at 0x%llx!", address);
+        return KERN_FAILURE;
+    }
+    return KERN_SUCCESS;
+}
+
+/*
+ * the IDT can live in a read only mapping on newer kernels, if the write is refused
+ * make the pages writable for the write and put the read only protection back
+ */
+static kern_return_t
+mach_write(struct memsource *source, const void *buffer, mach_vm_address_t address, size_t size)
+{
+    kern_return_t kr = STATS_SYSCALL(mach_vm_write(source->port, address, (vm_offset_t)buffer, (mach_msg_type_number_t)size));
+    if (kr == KERN_PROTECTION_FAILURE)
+    {
+        kr = STATS_SYSCALL(mach_vm_protect(source->port, address, size, FALSE, VM_PROT_READ | VM_PROT_WRITE));
+        if (kr == KERN_SUCCESS)
+        {
+            kr = STATS_SYSCALL(mach_vm_write(source->port, address, (vm_offset_t)buffer, (mach_msg_type_number_t)size));
+            STATS_SYSCALL(mach_vm_protect(source->port, address, size, FALSE, VM_PROT_READ));
+        }
+    }
+    if (kr != KERN_SUCCESS)
+    {
+        ERROR_MSG("mach_vm_write failed at 0x%llx!", address);
+        return KERN_FAILURE;
+    }
+    return KERN_SUCCESS;
+}
+
+static void
+mach_close(struct memsource *source)
+{
+    mach_port_deallocate(mach_task_self(), source->port);
+    source->port = 0;
+}
+
+int
+open_mach_source(struct memsource *source, mach_port_t port)
+{
+    memset(source, 0, sizeof(struct memsource));
+    source->name = "mach";
+    source->read = mach_read;
+    source->write = mach_write;
+    source->close = mach_close;
+    source->port = port;
+    source->fd = -1;
+    return 0;
+}
+#endif
+
+/* /dev/kmem source */
+
+static kern_return_t
+kmem_read(struct memsource *source, void *buffer, mach_vm_address_t address, size_t size)
+{
+    if(STATS_SYSCALL(lseek(source->fd, (off_t)address, SEEK_SET)) != (off_t)address)
+    {
+        READ_ERROR_MSG(source, "Error in lseek. Are you root?");
+        return KERN_FAILURE;
+    }
+    if(STATS_SYSCALL(read(source->fd, buffer, size)) != (ssize_t)size)
+    {
+        READ_ERROR_MSG(source, "Error while trying to read from kmem: %s.", strerror(errno));
+        return KERN_FAILURE;
+    }
+    return KERN_SUCCESS;
+}
+
+static kern_return_t
+kmem_write(struct memsource *source, const void *buffer, mach_vm_address_t address, size_t size)
+{
+    if(STATS_SYSCALL(lseek(source->fd, (off_t)address, SEEK_SET)) != (off_t)address)
+    {
+        ERROR_MSG("Error in lseek. Are you root?");
+        return KERN_FAILURE;
+    }
+    if(STATS_SYSCALL(write(source->fd, buffer, size)) != (ssize_t)size)
+    {
+        ERROR_MSG("Error while trying to write to kmem: %s.", strerror(errno));
+        return KERN_FAILURE;
+    }
+    return KERN_SUCCESS;
+}
+
+static void
+kmem_close(struct memsource *source)
+{
+    STATS_SYSCALL(close(source->fd));
+    source->fd = -1;
+}
+
+int
+open_kmem_source(struct memsource *source, const char *path)
+{
+    memset(source, 0, sizeof(struct memsource));
+    if( (source->fd = STATS_SYSCALL(open(path, O_RDWR))) == -1 )
+    {
+        return -1;
+    }
+    source->name = "kmem";
+    source->read = kmem_read;
+    source->write = kmem_write;
+    source->close = kmem_close;
+    return 0;
+}
+
+/* Flat image file source */
+
+/*
+ * the file is a raw dump of kernel memory starting at base
+ * everything is served straight from the read only mapping
+ */
+static const void *
+file_map(struct memsource *source, mach_vm_address_t address, size_t size)
+{
+    if (address < source->base ||
+        address - source->base > source->image_size ||
+        size > source->image_size - (address - source->base))
+    {
+        return NULL;
+    }
+    return source->image + (address - source->base);
+}
+
+static kern_return_t
+file_read(struct memsource *source, void *buffer, mach_vm_address_t address, size_t size)
+{
+    const void *ptr = file_map(source, address, size);
+    if (ptr == NULL)
+    {
+        READ_ERROR_MSG(source, "Address range 0x%llx-0x%llx is not available in the image.",
+                               (unsigned long long)address, (unsigned long long)(address + size));
+        return KERN_FAILURE;
+    }
+    memcpy(buffer, ptr, size);
+    return KERN_SUCCESS;
+}
+
+static void
+file_close(struct memsource *source)
+{
+    STATS_SYSCALL(munmap(source->image, source->image_size));
+    source->image = NULL;
+    source->image_size = 0;
+}
+
+int
+open_file_source(struct memsource *source, const char *path, mach_vm_address_t base)
+{
+    memset(source, 0, sizeof(struct memsource));
+    source->fd = -1;
+    
+    int fd = STATS_SYSCALL(open(path, O_RDONLY));
+    if (fd < 0)
+    {
+        ERROR_MSG("Failed to open image %s, %s.", path, strerror(errno));
+        return -1;
+    }
+    struct stat stat = {0};
+    if (STATS_SYSCALL(fstat(fd, &stat)) < 0 || stat.st_size == 0)
+    {
+        ERROR_MSG("Can't fstat image %s or it's empty.", path);
+        STATS_SYSCALL(close(fd));
+        return -1;
+    }
+    uint8_t *image = STATS_SYSCALL(mmap(0, stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0));
+    STATS_SYSCALL(close(fd));
+    if (image == MAP_FAILED)
+    {
+        ERROR_MSG("mmap of image %s failed, %s.", path, strerror(errno));
+        return -1;
+    }
+    /* a saved kcore or vmcore knows where its memory belongs */
+    if ((size_t)stat.st_size >= sizeof(Elf64_Ehdr) && memcmp(image, ELFMAG, SELFMAG) == 0 &&
+        ((const Elf64_Ehdr*)image)->e_type == ET_CORE)
+    {
+        STATS_SYSCALL(munmap(image, stat.st_size));
+        return open_core_source(source, path);
+    }
+    source->name = "file";
+    source->read = file_read;
+    source->map = file_map;
+    source->close = file_close;
+    source->image = image;
+    source->image_size = stat.st_size;
+    source->base = base;
+    return 0;
+}
+
+/* ELF core source, /proc/kcore or a saved copy */
+
+static int
+compare_core_segments(const void *a, const void *b)
+{
+    const struct core_segment *x = a;
+    const struct core_segment *y = b;
+    return x->start < y->start ? -1 : (x->start > y->start ? 1 : 0);
+}
+
+/*
+ * the segment index is sorted so finding the segment of an address is the same branch
+ * free search as the symbol index, a read crossing into the next segment continues there
+ */
+static kern_return_t
+core_read(struct memsource *source, void *buffer, mach_vm_address_t address, size_t size)
+{
+    uint8_t *p = buffer;
+    while (size > 0)
+    {
+        const struct core_segment *base = source->segments;
+        uint32_t n = source->nr_segments;
+        while (n > 1)
+        {
+            uint32_t half = n / 2;
+            base = (base[half].start <= address) ? base + half : base;
+            n -= half;
+        }
+        if (source->nr_segments == 0 || address < base->start || address >= base->end)
+        {
+            READ_ERROR_MSG(source, "Address 0x%llx is not in any segment of the core.", (unsigned long long)address);
+            return KERN_FAILURE;
+        }
+        size_t chunk = MIN(size, base->end - address);
+        ssize_t ret = STATS_SYSCALL(pread(source->fd, p, chunk, (off_t)(base->offset + (address - base->start))));
+        if (ret <= 0)
+        {
+            READ_ERROR_MSG(source, "Error while trying to read from the core at 0x%llx: %s.", (unsigned long long)address,
+                                   ret < 0 ? strerror(errno) : "end of file");
+            return KERN_FAILURE;
+        }
+        p += ret;
+        address += ret;
+        size -= ret;
+    }
+    return KERN_SUCCESS;
+}
+
+static void
+core_close(struct memsource *source)
+{
+    STATS_SYSCALL(close(source->fd));
+    source->fd = -1;
+    free(source->segments);
+    source->segments = NULL;
+    source->nr_segments = 0;
+}
+
+/*
+ * the kernel writes its KASLR offset into the VMCOREINFO note of kcore and vmcores
+ * as a KERNELOFFSET=hex line, it's what a saved core needs to be compared with -C
+ */
+static void
+read_core_kaslr_offset(struct memsource *source, const Elf64_Phdr *note)
+{
+    if (note->p_filesz < sizeof(Elf64_Nhdr) || note->p_filesz > CORE_MAX_NOTE_SIZE)
+    {
+        return;
+    }
+    char *buf = malloc(note->p_filesz + 1);
+    if (buf == NULL)
+    {
+        return;
+    }
+    ssize_t ret = STATS_SYSCALL(pread(source->fd, buf, note->p_filesz, (off_t)note->p_offset));
+    size_t offset = 0;
+    while (ret == (ssize_t)note->p_filesz && note->p_filesz - offset >= sizeof(Elf64_Nhdr))
+    {
+        Elf64_Nhdr nhdr;
+        memcpy(&nhdr, buf + offset, sizeof(nhdr));
+        /* name and descriptor are padded to 4 bytes */
+        uint64_t name_size = ((uint64_t)nhdr.n_namesz + 3) & ~3ULL;
+        uint64_t desc_size = ((uint64_t)nhdr.n_descsz + 3) & ~3ULL;
+        if (name_size + desc_size > note->p_filesz - offset - sizeof(Elf64_Nhdr))
+        {
+            break;
+        }
+        char *name = buf + offset + sizeof(Elf64_Nhdr);
+        char *desc = name + name_size;
+        if (nhdr.n_namesz == sizeof("VMCOREINFO") && memcmp(name, "VMCOREINFO", sizeof("VMCOREINFO")) == 0)
+        {
+            desc[nhdr.n_descsz] = '\0';
+            char *line = strstr(desc, "KERNELOFFSET=");
+            if (line != NULL)
+            {
+                source->kaslr_offset = strtoull(line + strlen("KERNELOFFSET="), NULL, 16);
+                source->has_kaslr_offset = 1;
+            }
+            break;
+        }
+        offset += sizeof(Elf64_Nhdr) + name_size + desc_size;
+    }
+    free(buf);
+}
+
+/*
+ * index the PT_LOAD segments of an ELF core once, reads are then a search and a pread
+ * only the part of a segment backed by the file is readable
+ */
+int
+open_core_source(struct memsource *source, const char *path)
+{
+    memset(source, 0, sizeof(struct memsource));
+    source->fd = STATS_SYSCALL(open(path, O_RDONLY));
+    if (source->fd < 0)
+    {
+        ERROR_MSG("Failed to open %s, %s.", path, strerror(errno));
+        return -1;
+    }
+    Elf64_Ehdr header;
+    memset(&header, 0, sizeof(header));
+    if (STATS_SYSCALL(pread(source->fd, &header, sizeof(header), 0)) != sizeof(header) ||
+        memcmp(header.e_ident, ELFMAG, SELFMAG) != 0 || header.e_ident[EI_CLASS] != ELFCLASS64 ||
+        header.e_type != ET_CORE || header.e_phentsize != sizeof(Elf64_Phdr))
+    {
+        ERROR_MSG("%s is not a 64 bits ELF core.", path);
+        core_close(source);
+        return -1;
+    }
+    size_t headers_size = (size_t)header.e_phnum * sizeof(Elf64_Phdr);
+    Elf64_Phdr *headers = malloc(headers_size);
+    source->segments = malloc((header.e_phnum + 1) * sizeof(struct core_segment));
+    if (headers == NULL || source->segments == NULL ||
+        STATS_SYSCALL(pread(source->fd, headers, headers_size, (off_t)header.e_phoff)) != (ssize_t)headers_size)
+    {
+        ERROR_MSG("Can't read the program headers of %s.", path);
+        free(headers);
+        core_close(source);
+        return -1;
+    }
+    for (uint32_t i = 0; i < header.e_phnum; i++)
+    {
+        if (headers[i].p_type == PT_NOTE && source->has_kaslr_offset == 0)
+        {
+            read_core_kaslr_offset(source, &headers[i]);
+        }
+        if (headers[i].p_type != PT_LOAD || headers[i].p_filesz == 0 || headers[i].p_vaddr + headers[i].p_filesz < headers[i].p_vaddr)
+        {
+            continue;
+        }
+        struct core_segment *segment = &source->segments[source->nr_segments++];
+        segment->start = headers[i].p_vaddr;
+        segment->end = headers[i].p_vaddr + headers[i].p_filesz;
+        segment->offset = headers[i].p_offset;
+    }
+    free(headers);
+    qsort(source->segments, source->nr_segments, sizeof(struct core_segment), compare_core_segments);
+    DEBUG_MSG("Indexed %u segments of %s.", source->nr_segments, path);
+    
+    source->name = "core";
+    source->read = core_read;
+    source->close = core_close;
+    return 0;
+}
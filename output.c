@@ -0,0 +1,252 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * output.c
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "output.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "decode.h"
+#include "stats.h"
+
+/*
+ * all report rows go into this buffer and reach stdout with one write() per report
+ * nothing is allocated while formatting
+ */
+static struct
+{
+    int format;
+    size_t used;
+    char buf[OUTPUT_BUFFER_SIZE];
+} g_output;
+
+/* local functions */
+static void output_reserve(size_t size);
+static void append_json_string(const char *str);
+
+int
+parse_output_format(const char *name, int *format)
+{
+    if (strcmp(name, "table") == 0)
+    {
+        *format = OUTPUT_FORMAT_TABLE;
+    }
+    else if (strcmp(name, "jsonl") == 0)
+    {
+        *format = OUTPUT_FORMAT_JSONL;
+    }
+    else if (strcmp(name, "bin") == 0)
+    {
+        *format = OUTPUT_FORMAT_BIN;
+    }
+    else
+    {
+        ERROR_MSG("Unknown output format %s.", name);
+        return -1;
+    }
+    g_output.format = *format;
+    return 0;
+}
+
+/* flush if there isn't room for size more bytes */
+static void
+output_reserve(size_t size)
+{
+    if (g_output.used + size > sizeof(g_output.buf))
+    {
+        output_flush();
+    }
+}
+
+static void
+append_json_string(const char *str)
+{
+    g_output.buf[g_output.used++] = '"';
+    for (const char *p = str; *p != '\0' && g_output.used < sizeof(g_output.buf) - 8; p++)
+    {
+        if (*p == '"' || *p == '\\')
+        {
+            g_output.buf[g_output.used++] = '\\';
+            g_output.buf[g_output.used++] = *p;
+        }
+        else if ((unsigned char)*p < 0x20)
+        {
+            g_output.used += snprintf(g_output.buf + g_output.used, 7, "\\u%04x", *p);
+        }
+        else
+        {
+            g_output.buf[g_output.used++] = *p;
+        }
+    }
+    g_output.buf[g_output.used++] = '"';
+}
+
+/* the column header of the human table */
+void
+output_table_header(int resolve)
+{
+    if (g_output.format != OUTPUT_FORMAT_TABLE)
+    {
+        return;
+    }
+    if(resolve == 1)
+    {
+        OUTPUT_MSG("* Interrupt  *    Stub Address    *   Segment   * DPL  *      Type       *     Handler Name     *");
+        OUTPUT_MSG("-------------------------------------------------------------------------------------------------");
+    }
+    else
+    {
+        OUTPUT_MSG("* Interrupt  *    Stub Address    *   Segment   * DPL  *      Type      *");
+        OUTPUT_MSG("-------------------------------------------------------------------------");
+    }
+}
+
+void
+output_entry(const struct output_entry *entry)
+{
+    /* worst case for a text row is a long symbol name plus the fixed fields */
+    uint64_t start = stats_begin();
+    size_t symbol_len = entry->symbol != NULL ? strlen(entry->symbol) : 0;
+    output_reserve(512 + symbol_len * 2);
+    char *out = g_output.buf + g_output.used;
+    size_t room = sizeof(g_output.buf) - g_output.used;
+    
+    switch (g_output.format)
+    {
+        case OUTPUT_FORMAT_JSONL:
+        {
+            static const char *status_names[] = { "none", "same", "changed" };
+            g_output.used += snprintf(out, room,
+                                      "{\"interrupt\":%u,\"stub\":\"0x%llx\",\"selector\":%u,\"segment\":\"%s\",\"dpl\":%u,"
+                                      "\"type\":\"%s\",\"ist\":%u,\"present\":%u,\"status\":\"%s\"",
+                                      entry->interrupt, (unsigned long long)entry->stub, entry->selector,
+                                      get_segment_name(entry->selector), entry->dpl, get_gate_type_name(entry->type),
+                                      entry->ist, entry->present, status_names[entry->status]);
+            if (entry->status == OUTPUT_STATUS_CHANGED)
+            {
+                g_output.used += snprintf(g_output.buf + g_output.used, sizeof(g_output.buf) - g_output.used,
+                                          ",\"old_stub\":\"0x%llx\"", (unsigned long long)entry->old_stub);
+            }
+            if (entry->timestamp != 0)
+            {
+                g_output.used += snprintf(g_output.buf + g_output.used, sizeof(g_output.buf) - g_output.used,
+                                          ",\"time\":%lld", (long long)entry->timestamp);
+            }
+            if (entry->symbol != NULL)
+            {
+                memcpy(g_output.buf + g_output.used, ",\"symbol\":", 10);
+                g_output.used += 10;
+                append_json_string(entry->symbol);
+            }
+            g_output.buf[g_output.used++] = '}';
+            g_output.buf[g_output.used++] = '\n';
+            break;
+        }
+        case OUTPUT_FORMAT_BIN:
+        {
+            struct output_bin_record record = {0};
+            record.stub = entry->stub;
+            record.old_stub = entry->old_stub;
+            record.interrupt = (uint16_t)entry->interrupt;
+            record.selector = entry->selector;
+            record.dpl = entry->dpl;
+            record.type = entry->type;
+            record.ist = entry->ist;
+            record.present = entry->present;
+            record.status = entry->status;
+            record.symbol_len = (uint16_t)MIN(symbol_len, 0xFFFF);
+            memcpy(out, &record, sizeof(record));
+            memcpy(out + sizeof(record), entry->symbol, record.symbol_len);
+            g_output.used += sizeof(record) + record.symbol_len;
+            break;
+        }
+        default:
+        {
+            if (entry->symbol != NULL)
+            {
+                g_output.used += snprintf(out, room, "      0x%-4x   0x%-16llx   %-12s   %-3i   %-16s  %s \n",
+                                          entry->interrupt, (unsigned long long)entry->stub, get_segment_name(entry->selector),
+                                          entry->dpl, get_gate_type_name(entry->type), entry->symbol);
+            }
+            else
+            {
+                g_output.used += snprintf(out, room, "      0x%-4x   0x%-16llx   %-12s   %-3i   %s \n",
+                                          entry->interrupt, (unsigned long long)entry->stub, get_segment_name(entry->selector),
+                                          entry->dpl, get_gate_type_name(entry->type));
+            }
+            break;
+        }
+    }
+    stats_end(STATS_PHASE_FORMAT, start);
+}
+
+/* write everything buffered with a single write(), stdio is flushed first to keep the order */
+void
+output_flush(void)
+{
+    if (g_output.used == 0)
+    {
+        return;
+    }
+    uint64_t start = stats_begin();
+    fflush(stdout);
+    size_t written = 0;
+    while (written < g_output.used)
+    {
+        ssize_t ret = STATS_SYSCALL(write(STDOUT_FILENO, g_output.buf + written, g_output.used - written));
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            ERROR_MSG("Failed to write output, %s.", strerror(errno));
+            break;
+        }
+        written += ret;
+    }
+    g_output.used = 0;
+    stats_end(STATS_PHASE_FORMAT, start);
+}
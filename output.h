@@ -0,0 +1,97 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * output.h
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef checkidt_output_h
+#define checkidt_output_h
+
+#include <stdint.h>
+#include "global.h"
+
+#define OUTPUT_BUFFER_SIZE      (256*1024)
+
+/* diff status of a record */
+#define OUTPUT_STATUS_NONE      0   /* not compared */
+#define OUTPUT_STATUS_SAME      1
+#define OUTPUT_STATUS_CHANGED   2
+
+/* one decoded interrupt as reported to the user */
+struct output_entry
+{
+    uint32_t interrupt;
+    uint64_t stub;
+    uint64_t old_stub;      /* only when status is OUTPUT_STATUS_CHANGED */
+    uint16_t selector;
+    uint8_t dpl;
+    uint8_t type;
+    uint8_t ist;
+    uint8_t present;
+    uint8_t status;
+    const char *symbol;     /* NULL if not resolved */
+    int64_t timestamp;      /* when it was seen (watch and history), 0 if not, jsonl only */
+};
+
+/*
+ * binary format record, little endian and packed
+ * followed by symbol_len bytes of symbol name without terminator
+ */
+struct output_bin_record
+{
+    uint64_t stub;
+    uint64_t old_stub;
+    uint16_t interrupt;
+    uint16_t selector;
+    uint8_t dpl;
+    uint8_t type;
+    uint8_t ist;
+    uint8_t present;
+    uint8_t status;
+    uint8_t reserved;
+    uint16_t symbol_len;
+} __attribute__((packed));
+
+int parse_output_format(const char *name, int *format);
+void output_table_header(int resolve);
+void output_entry(const struct output_entry *entry);
+void output_flush(void);
+
+#endif
@@ -0,0 +1,429 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * percpu.c
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+#include "percpu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#ifdef __APPLE__
+#include <mach/thread_policy.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#include "idt.h"
+#include "kernel.h"
+#include "diff.h"
+#include "hash.h"
+#include "decode.h"
+
+/* a distinct IDT (base, limit) pair and its contents */
+struct idt_table
+{
+    mach_vm_address_t base;
+    uint16_t limit;
+    uint32_t nr_cpus;
+    int valid;              /* the table could be read, hash is meaningless otherwise */
+    int unmapped;           /* an alias we can't read, only the IDTR is compared */
+    uint64_t hash;
+    struct idt_snapshot snapshot;
+};
+
+struct worker
+{
+    pthread_t thread;
+    volatile uint32_t *start;
+    struct cpu_idtr idtr;
+};
+
+/* local functions */
+static uint32_t get_apic_id(void);
+static void pin_to_cpu(uint32_t cpu);
+static void * capture_worker(void *arg);
+static uint32_t count_sampled_cpus(const struct worker *workers, long nr_workers);
+static mach_vm_address_t get_table_address(const struct config *cfg, mach_vm_address_t base);
+static void report_entry(mach_vm_address_t base, uint32_t x, const struct idt_model *reference, const struct idt_model *table);
+
+static uint32_t
+get_apic_id(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+    /* x2APIC id if available, else the 8 bits initial APIC id */
+    if (__get_cpuid_max(0, NULL) >= 0xB)
+    {
+        __cpuid_count(0xB, 0, eax, ebx, ecx, edx);
+        if (ebx != 0)
+        {
+            return edx;
+        }
+    }
+    __cpuid(1, eax, ebx, ecx, edx);
+    return ebx >> 24;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Linux can pin a thread to a cpu
+ * OS X only has affinity tags, threads with different tags are spread over different cores
+ * which is a hint and not a guarantee, so each capture also records the APIC id it ran on
+ */
+static void
+pin_to_cpu(uint32_t cpu)
+{
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(__APPLE__)
+    thread_affinity_policy_data_t policy = { (integer_t)cpu + 1 };
+    thread_policy_set(mach_thread_self(), THREAD_AFFINITY_POLICY, (thread_policy_t)&policy, THREAD_AFFINITY_POLICY_COUNT);
+#endif
+}
+
+/*
+ * runs on one cpu, waits for the start signal so all cpus execute sidt at the same time
+ * the APIC id is read before and after sidt, if they differ we migrated and try again
+ */
+static void *
+capture_worker(void *arg)
+{
+    struct worker *worker = arg;
+    pin_to_cpu(worker->idtr.cpu);
+    while (__atomic_load_n(worker->start, __ATOMIC_ACQUIRE) == 0)
+    {
+        sched_yield();
+    }
+    for (int i = 0; i < PERCPU_MAX_TRIES; i++)
+    {
+        uint32_t before = get_apic_id();
+        mach_vm_address_t base = get_addr_idt(X64);
+        uint16_t limit = get_size_idt();
+        if (get_apic_id() == before)
+        {
+            worker->idtr.apic_id = before;
+            worker->idtr.base = base;
+            worker->idtr.limit = limit;
+            worker->idtr.valid = 1;
+            break;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * how many different cpus the valid captures really ran on
+ * affinity tags can put several workers on the same core and the others are never seen
+ */
+static uint32_t
+count_sampled_cpus(const struct worker *workers, long nr_workers)
+{
+    uint32_t count = 0;
+    for (long i = 0; i < nr_workers; i++)
+    {
+        if (workers[i].idtr.valid == 0)
+        {
+            continue;
+        }
+        long j = 0;
+        for (j = 0; j < i; j++)
+        {
+            if (workers[j].idtr.valid == 1 && workers[j].idtr.apic_id == workers[i].idtr.apic_id)
+            {
+                break;
+            }
+        }
+        count += j == i;
+    }
+    return count;
+}
+
+/*
+ * where the table an IDTR points to can be read, 0 if it can't
+ * on Linux the cpu entry area alias is the same memory as idt_table, which checkidt_open_live()
+ * found from the symbols, without that symbol we only know the alias
+ */
+static mach_vm_address_t
+get_table_address(const struct config *cfg, mach_vm_address_t base)
+{
+#ifdef __linux__
+    if (base - LINUX_CEA_BASE < LINUX_CEA_SIZE)
+    {
+        return cfg->idt_addr - LINUX_CEA_BASE < LINUX_CEA_SIZE ? 0 : cfg->idt_addr;
+    }
+#else
+    (void)cfg;
+#endif
+    return base;
+}
+
+/* every field of an entry that differs from the majority table */
+static void
+report_entry(mach_vm_address_t base, uint32_t x, const struct idt_model *reference, const struct idt_model *table)
+{
+    if (table->stub[x] != reference->stub[x])
+    {
+        ERROR_MSG("IDT 0x%llx interrupt 0x%x: handler 0x%llx instead of 0x%llx.", (unsigned long long)base, x,
+                  (unsigned long long)table->stub[x], (unsigned long long)reference->stub[x]);
+    }
+    if (table->selector[x] != reference->selector[x])
+    {
+        ERROR_MSG("IDT 0x%llx interrupt 0x%x: selector 0x%x instead of 0x%x.", (unsigned long long)base, x,
+                  table->selector[x], reference->selector[x]);
+    }
+    if (table->dpl[x] != reference->dpl[x])
+    {
+        ERROR_MSG("IDT 0x%llx interrupt 0x%x: DPL %u instead of %u.", (unsigned long long)base, x,
+                  table->dpl[x], reference->dpl[x]);
+    }
+    if (table->type[x] != reference->type[x])
+    {
+        ERROR_MSG("IDT 0x%llx interrupt 0x%x: %s instead of %s.", (unsigned long long)base, x,
+                  get_gate_type_name(table->type[x]), get_gate_type_name(reference->type[x]));
+    }
+    if (table->present[x] != reference->present[x])
+    {
+        ERROR_MSG("IDT 0x%llx interrupt 0x%x: present bit %u instead of %u.", (unsigned long long)base, x,
+                  table->present[x], reference->present[x]);
+    }
+    if (table->ist[x] != reference->ist[x])
+    {
+        ERROR_MSG("IDT 0x%llx interrupt 0x%x: IST %u instead of %u.", (unsigned long long)base, x,
+                  table->ist[x], reference->ist[x]);
+    }
+}
+
+/*
+ * capture IDTR on every logical cpu in parallel and group cpus by identical tables
+ * IDTR is the only per cpu state, the table itself lives in kernel memory and looks the same
+ * from every core, so each distinct (base, limit) is read once in bulk and hashed
+ * the report only lists cpus that disagree with the majority
+ * on Linux without an idt_table symbol the cpu entry area alias can't be read through /proc/kcore,
+ * so only the IDTR of each cpu is compared
+ * returns 0 if every cpu uses the same IDT, 1 if not, -1 on errors
+ */
+int
+check_percpu_idt(struct config *cfg)
+{
+    long nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nr_cpus <= 0)
+    {
+        ERROR_MSG("Can't retrieve number of cpus.");
+        return -1;
+    }
+    if (nr_cpus > PERCPU_MAX_CPUS)
+    {
+        nr_cpus = PERCPU_MAX_CPUS;
+    }
+    
+    struct worker *workers = calloc(nr_cpus, sizeof(struct worker));
+    struct idt_table *tables = calloc(nr_cpus, sizeof(struct idt_table));
+    /* the reference and the table being compared, decoded when they differ */
+    struct idt_model *models = calloc(2, sizeof(struct idt_model));
+    if (workers == NULL || tables == NULL || models == NULL)
+    {
+        ERROR_MSG("Can't allocate memory for %ld cpus.", nr_cpus);
+        free(workers);
+        free(tables);
+        free(models);
+        return -1;
+    }
+    
+    volatile uint32_t start = 0;
+    long nr_started = 0;
+    for (long i = 0; i < nr_cpus; i++)
+    {
+        workers[i].idtr.cpu = (uint32_t)i;
+        workers[i].start = &start;
+        if (pthread_create(&workers[i].thread, NULL, capture_worker, &workers[i]) != 0)
+        {
+            ERROR_MSG("Failed to start worker for cpu %ld.", i);
+            break;
+        }
+        nr_started++;
+    }
+    __atomic_store_n(&start, 1, __ATOMIC_RELEASE);
+    for (long i = 0; i < nr_started; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+    }
+    
+    /* group cpus by IDTR */
+    uint32_t nr_tables = 0;
+    for (long i = 0; i < nr_started; i++)
+    {
+        struct cpu_idtr *idtr = &workers[i].idtr;
+        if (idtr->valid == 0)
+        {
+            ERROR_MSG("Worker %u never got a stable capture.", idtr->cpu);
+            continue;
+        }
+        uint32_t t = 0;
+        for (t = 0; t < nr_tables; t++)
+        {
+            if (tables[t].base == idtr->base && tables[t].limit == idtr->limit)
+            {
+                break;
+            }
+        }
+        if (t == nr_tables)
+        {
+            tables[t].base = idtr->base;
+            tables[t].limit = idtr->limit;
+            nr_tables++;
+        }
+        tables[t].nr_cpus++;
+        idtr->table = t;
+    }
+    
+    /* one bulk read per distinct table */
+    uint32_t majority = 0;
+    for (uint32_t t = 0; t < nr_tables; t++)
+    {
+        if (tables[t].nr_cpus > tables[majority].nr_cpus)
+        {
+            majority = t;
+        }
+        struct config table_cfg = *cfg;
+        table_cfg.idt_addr = get_table_address(cfg, tables[t].base);
+        table_cfg.idt_size = tables[t].limit;
+        if (table_cfg.idt_addr == 0)
+        {
+            INFO_MSG(cfg, "[INFO] IDT 0x%llx is the cpu entry area alias and there is no idt_table symbol, only comparing IDTR.",
+                          (unsigned long long)tables[t].base);
+            tables[t].unmapped = 1;
+        }
+        else if (read_idt_snapshot(&table_cfg, &tables[t].snapshot) == KERN_SUCCESS)
+        {
+            tables[t].hash = hash64(tables[t].snapshot.descriptors,
+                                    tables[t].snapshot.nr_entries * sizeof(struct descriptor_idt), 0);
+            tables[t].valid = 1;
+        }
+        else
+        {
+            ERROR_MSG("Can't read the IDT at 0x%llx limit 0x%x.", (unsigned long long)tables[t].base, tables[t].limit);
+        }
+    }
+    
+    uint32_t nr_sampled = count_sampled_cpus(workers, nr_started);
+    INFO_MSG(cfg, "[INFO] Captured IDTR on %u of %ld cpus, %u distinct IDT(s).", nr_sampled, nr_cpus, nr_tables);
+    if (nr_tables == 0)
+    {
+        free(workers);
+        free(tables);
+        free(models);
+        return -1;
+    }
+    struct idt_table *reference = &tables[majority];
+    INFO_MSG(cfg, "[INFO] Majority IDT at 0x%llx limit 0x%x on %u cpus, hash 0x%016llx.",
+                  (unsigned long long)reference->base, reference->limit, reference->nr_cpus,
+                  (unsigned long long)reference->hash);
+    
+    int differences = 0;
+    if (nr_sampled < (uint32_t)nr_cpus)
+    {
+        /* the cpus we never ran on could be using any IDT */
+        ERROR_MSG("Only %u of %ld cpus were sampled, some workers ran on the same cpu.", nr_sampled, nr_cpus);
+        differences = 1;
+    }
+    if (reference->valid == 0 && reference->unmapped == 0)
+    {
+        ERROR_MSG("Can't compare the cpus, the majority IDT is unreadable.");
+        differences = 1;
+    }
+    for (long i = 0; i < nr_started; i++)
+    {
+        struct cpu_idtr *idtr = &workers[i].idtr;
+        if (idtr->valid == 0 || idtr->table == majority)
+        {
+            continue;
+        }
+        differences = 1;
+        struct idt_table *table = &tables[idtr->table];
+        ERROR_MSG("CPU %u (APIC id %u) uses IDT at 0x%llx limit 0x%x, hash 0x%016llx.",
+                  idtr->cpu, idtr->apic_id, (unsigned long long)idtr->base, idtr->limit,
+                  (unsigned long long)table->hash);
+    }
+    /* and what is different inside each table that isn't the majority */
+    struct idt_model *reference_model = &models[0];
+    struct idt_model *table_model = &models[1];
+    for (uint32_t t = 0; t < nr_tables; t++)
+    {
+        if (t == majority || tables[t].valid == 0 || reference->valid == 0 || tables[t].hash == reference->hash)
+        {
+            continue;
+        }
+        struct idt_diff diff = {0};
+        uint32_t nr_entries = MIN(tables[t].snapshot.nr_entries, reference->snapshot.nr_entries);
+        diff_idt_tables(reference->snapshot.descriptors, tables[t].snapshot.descriptors, nr_entries, cfg->diff_fields, &diff);
+        decode_idt(reference->snapshot.descriptors, nr_entries, cfg->kernel_type, reference_model);
+        decode_idt(tables[t].snapshot.descriptors, nr_entries, cfg->kernel_type, table_model);
+        for (uint32_t x = 0; x < nr_entries; x++)
+        {
+            if (diff_entry_changed(&diff, x))
+            {
+                report_entry(tables[t].base, x, reference_model, table_model);
+            }
+        }
+    }
+    if (differences == 0)
+    {
+        INFO_MSG(cfg, "[OK] All cpus use the same IDT.");
+    }
+    
+    free(workers);
+    free(tables);
+    free(models);
+    return differences;
+}
@@ -0,0 +1,221 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * pool.c
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "global.h"
+
+/*
+ * each worker owns a range of task indexes and takes work from its front
+ * an idle worker steals the back half of another worker's range
+ * tasks never create new tasks so a full pass over all ranges without finding
+ * anything means everything has been handed out
+ */
+struct pool_queue
+{
+    pthread_mutex_t lock;
+    size_t begin;
+    size_t end;
+} __attribute__((aligned(64)));
+
+struct pool
+{
+    struct pool_queue *queues;
+    uint32_t nr_threads;
+    pool_task_t task;
+    void *context;
+};
+
+struct pool_worker
+{
+    pthread_t thread;
+    struct pool *pool;
+    uint32_t id;
+};
+
+/* local functions */
+static int pop_task(struct pool_queue *queue, size_t *index);
+static int steal_tasks(struct pool *pool, uint32_t thief);
+static void * pool_worker(void *arg);
+
+uint32_t
+pool_default_threads(void)
+{
+    long nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nr_cpus <= 0)
+    {
+        return 1;
+    }
+    return nr_cpus > POOL_MAX_THREADS ? POOL_MAX_THREADS : (uint32_t)nr_cpus;
+}
+
+static int
+pop_task(struct pool_queue *queue, size_t *index)
+{
+    int found = 0;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->begin < queue->end)
+    {
+        *index = queue->begin++;
+        found = 1;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+/* move the back half of the first non empty victim into the thief's own queue */
+static int
+steal_tasks(struct pool *pool, uint32_t thief)
+{
+    for (uint32_t i = 1; i < pool->nr_threads; i++)
+    {
+        struct pool_queue *victim = &pool->queues[(thief + i) % pool->nr_threads];
+        size_t begin = 0, end = 0;
+        pthread_mutex_lock(&victim->lock);
+        if (victim->begin < victim->end)
+        {
+            size_t half = (victim->end - victim->begin + 1) / 2;
+            end = victim->end;
+            begin = end - half;
+            victim->end = begin;
+        }
+        pthread_mutex_unlock(&victim->lock);
+        if (begin < end)
+        {
+            struct pool_queue *own = &pool->queues[thief];
+            pthread_mutex_lock(&own->lock);
+            own->begin = begin;
+            own->end = end;
+            pthread_mutex_unlock(&own->lock);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void *
+pool_worker(void *arg)
+{
+    struct pool_worker *worker = arg;
+    struct pool *pool = worker->pool;
+    size_t index = 0;
+    
+    do
+    {
+        while (pop_task(&pool->queues[worker->id], &index))
+        {
+            pool->task(pool->context, index, worker->id);
+        }
+    } while (steal_tasks(pool, worker->id));
+    return NULL;
+}
+
+/*
+ * run task(context, i, worker) for every i in [0, nr_tasks) on nr_threads threads
+ * the calling thread works as worker 0 and the call returns when all tasks are done
+ */
+int
+run_pool(size_t nr_tasks, uint32_t nr_threads, pool_task_t task, void *context)
+{
+    if (nr_threads == 0)
+    {
+        nr_threads = pool_default_threads();
+    }
+    if (nr_threads > POOL_MAX_THREADS)
+    {
+        nr_threads = POOL_MAX_THREADS;
+    }
+    if ((size_t)nr_threads > nr_tasks)
+    {
+        nr_threads = nr_tasks > 0 ? (uint32_t)nr_tasks : 1;
+    }
+    
+    struct pool pool = { .nr_threads = nr_threads, .task = task, .context = context };
+    struct pool_worker *workers = calloc(nr_threads, sizeof(struct pool_worker));
+    if (posix_memalign((void**)&pool.queues, 64, nr_threads * sizeof(struct pool_queue)) != 0 || workers == NULL)
+    {
+        ERROR_MSG("Can't allocate thread pool.");
+        free(workers);
+        return -1;
+    }
+    
+    /* even split to start with, stealing takes care of uneven task costs */
+    for (uint32_t i = 0; i < nr_threads; i++)
+    {
+        pthread_mutex_init(&pool.queues[i].lock, NULL);
+        pool.queues[i].begin = nr_tasks * i / nr_threads;
+        pool.queues[i].end = nr_tasks * (i + 1) / nr_threads;
+        workers[i].pool = &pool;
+        workers[i].id = i;
+    }
+    
+    uint32_t nr_started = 1;
+    for (uint32_t i = 1; i < nr_threads; i++)
+    {
+        if (pthread_create(&workers[i].thread, NULL, pool_worker, &workers[i]) != 0)
+        {
+            /* the remaining queues get stolen by the threads we have */
+            break;
+        }
+        nr_started++;
+    }
+    pool_worker(&workers[0]);
+    for (uint32_t i = 1; i < nr_started; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+    }
+    
+    for (uint32_t i = 0; i < nr_threads; i++)
+    {
+        pthread_mutex_destroy(&pool.queues[i].lock);
+    }
+    free(pool.queues);
+    free(workers);
+    return 0;
+}
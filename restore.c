@@ -0,0 +1,147 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * restore.c
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "restore.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "idt.h"
+#include "kernel.h"
+#include "output.h"
+
+/* local functions */
+static uint32_t verify_restore(struct config *cfg, const struct descriptor_idt *wanted, const struct restore_run *runs, uint32_t nr_runs);
+
+/*
+ * turn the dirty bitmap into runs of adjacent entries, each run is a single write
+ * returns the number of runs, at most half the entries rounded up
+ */
+uint32_t
+build_restore_runs(const struct idt_diff *diff, uint32_t nr_entries, struct restore_run *runs)
+{
+    uint32_t nr_runs = 0;
+    uint32_t x = 0;
+    while (x < nr_entries)
+    {
+        if (diff_entry_changed(diff, x) == 0)
+        {
+            x++;
+            continue;
+        }
+        runs[nr_runs].first = x;
+        while (x < nr_entries && diff_entry_changed(diff, x) == 1)
+        {
+            x++;
+        }
+        runs[nr_runs].count = x - runs[nr_runs].first;
+        nr_runs++;
+    }
+    return nr_runs;
+}
+
+/* one bulk read of the table, returns the number of restored entries that didn't stick */
+static uint32_t
+verify_restore(struct config *cfg, const struct descriptor_idt *wanted, const struct restore_run *runs, uint32_t nr_runs)
+{
+    struct idt_snapshot check = {0};
+    uint32_t nr_failed = 0;
+    if (read_idt_snapshot(cfg, &check) != KERN_SUCCESS)
+    {
+        ERROR_MSG("Can't read back the IDT to verify the restore.");
+        for (uint32_t r = 0; r < nr_runs; r++)
+        {
+            nr_failed += runs[r].count;
+        }
+        return nr_failed;
+    }
+    for (uint32_t r = 0; r < nr_runs; r++)
+    {
+        for (uint32_t x = runs[r].first; x < runs[r].first + runs[r].count; x++)
+        {
+            if (x >= check.nr_entries || memcmp(&check.descriptors[x], &wanted[x], sizeof(struct descriptor_idt)) != 0)
+            {
+                ERROR_MSG("Descriptor of interrupt %u didn't stick after the restore.", x);
+                nr_failed++;
+            }
+        }
+    }
+    return nr_failed;
+}
+
+/*
+ * write the flagged entries of wanted back to the IDT with as few writes as possible
+ * and read the table back once to check all of them
+ * wanted is the complete corrected table, only the flagged entries are written
+ */
+int
+restore_idt_entries(struct config *cfg, const struct descriptor_idt *wanted, const struct idt_diff *diff, uint32_t nr_entries)
+{
+    struct restore_run runs[IDT_MAX_ENTRIES / 2 + 1];
+    uint32_t nr_runs = build_restore_runs(diff, MIN(nr_entries, IDT_MAX_ENTRIES), runs);
+    uint32_t nr_written = 0;
+    
+    for (uint32_t r = 0; r < nr_runs; r++)
+    {
+        if (writekmem(cfg, (void*)&wanted[runs[r].first], cfg->idt_addr + runs[r].first * sizeof(struct descriptor_idt),
+                      runs[r].count * sizeof(struct descriptor_idt)) != KERN_SUCCESS)
+        {
+            ERROR_MSG("Failed to restore interrupts 0x%x-0x%x.", runs[r].first, runs[r].first + runs[r].count - 1);
+            continue;
+        }
+        nr_written += runs[r].count;
+    }
+    /* a failed write is caught here too, its entries still hold the hooked values */
+    uint32_t nr_failed = verify_restore(cfg, wanted, runs, nr_runs);
+    if (nr_failed != 0)
+    {
+        ERROR_MSG("%u of %u descriptors were not restored.", nr_failed, diff->nr_changed);
+        return -1;
+    }
+    if (cfg->output_format == OUTPUT_FORMAT_TABLE)
+    {
+        OUTPUT_MSG("[OK] Restored %u descriptors with %u writes, all verified.", nr_written, nr_runs);
+    }
+    return 0;
+}
@@ -0,0 +1,142 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * stats.c
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "stats.h"
+
+#include <stdio.h>
+#include <string.h>
+
+struct stats g_stats;
+
+static const char *phase_names[STATS_NR_PHASES] =
+{
+    "kernel_info", "kernel_port", "idt_read", "symbols", "compare", "archive", "format",
+    "trampolines", "syscalls", "total"
+};
+
+static const char *counter_names[STATS_NR_COUNTERS] =
+{
+    "readkmem_calls", "bytes_read", "writekmem_calls", "bytes_written",
+    "syscalls", "symbols_loaded", "symbol_lookups", "symbol_cache_hits"
+};
+
+int
+parse_stats_format(const char *name, int *format)
+{
+    if (name == NULL || strcmp(name, "text") == 0)
+    {
+        *format = STATS_FORMAT_TEXT;
+    }
+    else if (strcmp(name, "kv") == 0)
+    {
+        *format = STATS_FORMAT_KV;
+    }
+    else if (strcmp(name, "json") == 0)
+    {
+        *format = STATS_FORMAT_JSON;
+    }
+    else
+    {
+        ERROR_MSG("Unknown stats format %s, use text, kv or json.", name);
+        return -1;
+    }
+    return 0;
+}
+
+/* stats go to stderr so they never mix with the report itself */
+void
+print_stats(int format)
+{
+    switch (format)
+    {
+        case STATS_FORMAT_KV:
+        {
+            for (uint32_t i = 0; i < STATS_NR_PHASES; i++)
+            {
+                fprintf(stderr, "phase.%s.ns=%llu\nphase.%s.calls=%llu\n",
+                        phase_names[i], (unsigned long long)g_stats.phase_ns[i],
+                        phase_names[i], (unsigned long long)g_stats.phase_calls[i]);
+            }
+            for (uint32_t i = 0; i < STATS_NR_COUNTERS; i++)
+            {
+                fprintf(stderr, "%s=%llu\n", counter_names[i], (unsigned long long)g_stats.counters[i]);
+            }
+            break;
+        }
+        case STATS_FORMAT_JSON:
+        {
+            fprintf(stderr, "{\"phases\":{");
+            for (uint32_t i = 0; i < STATS_NR_PHASES; i++)
+            {
+                fprintf(stderr, "%s\"%s\":{\"ns\":%llu,\"calls\":%llu}", i ? "," : "", phase_names[i],
+                        (unsigned long long)g_stats.phase_ns[i], (unsigned long long)g_stats.phase_calls[i]);
+            }
+            fprintf(stderr, "},\"counters\":{");
+            for (uint32_t i = 0; i < STATS_NR_COUNTERS; i++)
+            {
+                fprintf(stderr, "%s\"%s\":%llu", i ? "," : "", counter_names[i], (unsigned long long)g_stats.counters[i]);
+            }
+            fprintf(stderr, "}}\n");
+            break;
+        }
+        default:
+        {
+            fprintf(stderr, "[STATS] %-12s %12s %8s\n", "phase", "ms", "calls");
+            for (uint32_t i = 0; i < STATS_NR_PHASES; i++)
+            {
+                if (g_stats.phase_calls[i] == 0)
+                {
+                    continue;
+                }
+                fprintf(stderr, "[STATS] %-12s %12.3f %8llu\n", phase_names[i],
+                        g_stats.phase_ns[i] / 1e6, (unsigned long long)g_stats.phase_calls[i]);
+            }
+            for (uint32_t i = 0; i < STATS_NR_COUNTERS; i++)
+            {
+                fprintf(stderr, "[STATS] %-18s %llu\n", counter_names[i], (unsigned long long)g_stats.counters[i]);
+            }
+            break;
+        }
+    }
+}
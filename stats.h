@@ -0,0 +1,139 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * stats.h
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef checkidt_stats_h
+#define checkidt_stats_h
+
+#include <stdint.h>
+#include "global.h"
+#include "timer.h"
+
+/* timed phases */
+#define STATS_PHASE_KERNEL_INFO     0   /* kernel type, version and kaslr sysctls */
+#define STATS_PHASE_KERNEL_PORT     1   /* processor_set_tasks probe and /dev/kmem open */
+#define STATS_PHASE_IDT_READ        2
+#define STATS_PHASE_SYMBOLS         3
+#define STATS_PHASE_COMPARE         4
+#define STATS_PHASE_ARCHIVE         5
+#define STATS_PHASE_FORMAT          6   /* building and writing reports */
+#define STATS_PHASE_TRAMPOLINES     7
+#define STATS_PHASE_SYSCALLS        8
+#define STATS_PHASE_TOTAL           9
+#define STATS_NR_PHASES             10
+
+/* counters */
+#define STATS_READKMEM_CALLS        0
+#define STATS_BYTES_READ            1
+#define STATS_WRITEKMEM_CALLS       2
+#define STATS_BYTES_WRITTEN         3
+#define STATS_SYSCALLS              4   /* calls wrapped in STATS_SYSCALL() */
+#define STATS_SYMBOLS_LOADED        5
+#define STATS_SYMBOL_LOOKUPS        6
+#define STATS_SYMBOL_CACHE_HITS     7
+#define STATS_NR_COUNTERS           8
+
+/* --stats output formats */
+#define STATS_FORMAT_TEXT           0
+#define STATS_FORMAT_KV             1
+#define STATS_FORMAT_JSON           2
+
+/*
+ * always collected, a counter is one relaxed atomic add and a phase two clock reads
+ * so there is no reason to turn them off, --stats only decides if they are printed
+ */
+struct stats
+{
+    uint64_t phase_ns[STATS_NR_PHASES];
+    uint64_t phase_calls[STATS_NR_PHASES];
+    uint64_t counters[STATS_NR_COUNTERS];
+};
+
+extern struct stats g_stats;
+
+static inline void
+stats_add(uint32_t counter, uint64_t value)
+{
+    __atomic_fetch_add(&g_stats.counters[counter], value, __ATOMIC_RELAXED);
+}
+
+/* wraps a syscall or mach trap where it is made, so every path that issues one counts it */
+#define STATS_SYSCALL(call)     (stats_add(STATS_SYSCALLS, 1), (call))
+
+static inline uint64_t
+stats_begin(void)
+{
+    return monotonic_ns();
+}
+
+static inline void
+stats_end(uint32_t phase, uint64_t start)
+{
+    __atomic_fetch_add(&g_stats.phase_ns[phase], monotonic_ns() - start, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&g_stats.phase_calls[phase], 1, __ATOMIC_RELAXED);
+}
+
+/* time spent so far in the phases that run inside others */
+static inline uint64_t
+stats_nested_ns(void)
+{
+    return __atomic_load_n(&g_stats.phase_ns[STATS_PHASE_IDT_READ], __ATOMIC_RELAXED) +
+           __atomic_load_n(&g_stats.phase_ns[STATS_PHASE_SYMBOLS], __ATOMIC_RELAXED) +
+           __atomic_load_n(&g_stats.phase_ns[STATS_PHASE_FORMAT], __ATOMIC_RELAXED);
+}
+
+/* end a phase that can contain others, nested is stats_nested_ns() at its start */
+static inline void
+stats_end_outer(uint32_t phase, uint64_t start, uint64_t nested)
+{
+    uint64_t elapsed = monotonic_ns() - start;
+    uint64_t inner = stats_nested_ns() - nested;
+    /* nested phases on other threads can add up to more than the wall time */
+    __atomic_fetch_add(&g_stats.phase_ns[phase], inner < elapsed ? elapsed - inner : 0, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&g_stats.phase_calls[phase], 1, __ATOMIC_RELAXED);
+}
+
+int parse_stats_format(const char *name, int *format);
+void print_stats(int format);
+
+#endif
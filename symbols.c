@@ -0,0 +1,339 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * symbols.c
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "symbols.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "pool.h"
+
+/* a sorted run of entries inside one of the build buffers */
+struct symbol_run
+{
+    uint32_t offset;
+    uint32_t count;
+};
+
+struct symbol_build
+{
+    symbol_filter_t filter;
+    const void *context;
+    uint32_t nr_items;
+    uint32_t chunk_size;
+    struct symbol_entry *src;
+    struct symbol_entry *dst;
+    struct symbol_run *runs;
+    struct symbol_run *next_runs;
+    uint32_t nr_runs;
+};
+
+/* local functions */
+static int compare_symbol_entries(const void *a, const void *b);
+static void filter_chunk(void *context, size_t index, uint32_t worker);
+static void merge_runs(void *context, size_t index, uint32_t worker);
+static void run_build_tasks(size_t nr_tasks, uint32_t nr_threads, pool_task_t task, struct symbol_build *build);
+
+/*
+ * allocate space for capacity symbols and a strings_size string table in one block
+ * the caller fills the strings through the returned pointer
+ */
+int
+symbol_index_init(struct symbol_index *index, uint32_t capacity, uint32_t strings_size, char **strings)
+{
+    memset(index, 0, sizeof(struct symbol_index));
+    size_t entries_size = (size_t)capacity * sizeof(struct symbol_entry);
+    if (entries_size + strings_size == 0)
+    {
+        return 0;
+    }
+    index->entries = malloc(entries_size + strings_size);
+    if (index->entries == NULL)
+    {
+        ERROR_MSG("Can't allocate memory for %u symbols.", capacity);
+        return -1;
+    }
+    index->capacity = capacity;
+    *strings = (char*)index->entries + entries_size;
+    index->strings = *strings;
+    index->strings_size = strings_size;
+    return 0;
+}
+
+void
+symbol_index_add(struct symbol_index *index, uint64_t address, uint32_t name_off)
+{
+    if (index->nr_entries >= index->capacity)
+    {
+        return;
+    }
+    struct symbol_entry *entry = &index->entries[index->nr_entries++];
+    entry->address = address;
+    entry->name_off = name_off;
+    entry->reserved = 0;
+}
+
+/* order by address, name offset breaks ties so the result is always the same */
+static int
+compare_symbol_entries(const void *a, const void *b)
+{
+    const struct symbol_entry *x = a;
+    const struct symbol_entry *y = b;
+    if (x->address != y->address)
+    {
+        return x->address < y->address ? -1 : 1;
+    }
+    if (x->name_off != y->name_off)
+    {
+        return x->name_off < y->name_off ? -1 : 1;
+    }
+    return 0;
+}
+
+void
+symbol_index_sort(struct symbol_index *index)
+{
+    qsort(index->entries, index->nr_entries, sizeof(struct symbol_entry), compare_symbol_entries);
+}
+
+/* pool task, filter one chunk of items in place and sort it */
+static void
+filter_chunk(void *context, size_t index, uint32_t worker)
+{
+    (void)worker;
+    struct symbol_build *build = context;
+    uint32_t begin = (uint32_t)index * build->chunk_size;
+    uint32_t end = MIN(begin + build->chunk_size, build->nr_items);
+    /* a chunk never produces more entries than items so it can't overflow into the next one */
+    uint32_t count = build->filter(build->context, begin, end, build->src + begin);
+    qsort(build->src + begin, count, sizeof(struct symbol_entry), compare_symbol_entries);
+    build->runs[index].offset = begin;
+    build->runs[index].count = count;
+}
+
+/* pool task, merge runs 2*index and 2*index+1 into dst, an odd last run is just copied */
+static void
+merge_runs(void *context, size_t index, uint32_t worker)
+{
+    (void)worker;
+    struct symbol_build *build = context;
+    const struct symbol_run *a = &build->runs[2 * index];
+    const struct symbol_run *b = (2 * index + 1 < build->nr_runs) ? &build->runs[2 * index + 1] : NULL;
+    const struct symbol_entry *x = build->src + a->offset, *x_end = x + a->count;
+    const struct symbol_entry *y = NULL, *y_end = NULL;
+    struct symbol_entry *out = build->dst + build->next_runs[index].offset;
+    if (b != NULL)
+    {
+        y = build->src + b->offset;
+        y_end = y + b->count;
+        /* ties take from the left run so the merge is stable */
+        while (x < x_end && y < y_end)
+        {
+            *out++ = (compare_symbol_entries(y, x) < 0) ? *y++ : *x++;
+        }
+        memcpy(out, y, (y_end - y) * sizeof(struct symbol_entry));
+        out += y_end - y;
+    }
+    memcpy(out, x, (x_end - x) * sizeof(struct symbol_entry));
+}
+
+/*
+ * every round must complete before the next one reads its output
+ * if the pool can't be set up the tasks run here, slower but the index is still sorted
+ */
+static void
+run_build_tasks(size_t nr_tasks, uint32_t nr_threads, pool_task_t task, struct symbol_build *build)
+{
+    if (run_pool(nr_tasks, nr_threads, task, build) == 0)
+    {
+        return;
+    }
+    for (size_t i = 0; i < nr_tasks; i++)
+    {
+        task(build, i, 0);
+    }
+}
+
+/*
+ * build the sorted index from nr_items raw symbols, the index must have room for nr_items
+ * items are split in chunks that are filtered and sorted in parallel, then the sorted runs
+ * are merged pairwise, one parallel round per level, until one run is left
+ * the order is total so the result is the same as a serial filter and sort
+ */
+int
+symbol_index_build(struct symbol_index *index, uint32_t nr_items, symbol_filter_t filter, const void *context, uint32_t nr_threads)
+{
+    if (nr_items > index->capacity)
+    {
+        ERROR_MSG("Symbol index too small for %u symbols.", nr_items);
+        return -1;
+    }
+    if (nr_threads == 0)
+    {
+        nr_threads = pool_default_threads();
+    }
+    struct symbol_build build = { .filter = filter, .context = context, .nr_items = nr_items };
+    /* a few chunks per thread so stealing can even out the sort times */
+    build.chunk_size = MAX(SYMBOL_MIN_CHUNK, (nr_items + nr_threads * 4 - 1) / (nr_threads * 4));
+    uint32_t nr_chunks = (nr_items + build.chunk_size - 1) / build.chunk_size;
+    if (nr_chunks <= 1)
+    {
+        index->nr_entries = filter(context, 0, nr_items, index->entries);
+        symbol_index_sort(index);
+        return 0;
+    }
+    
+    struct symbol_entry *scratch = malloc((size_t)nr_items * sizeof(struct symbol_entry));
+    build.runs = malloc(nr_chunks * sizeof(struct symbol_run));
+    build.next_runs = malloc(((nr_chunks + 1) / 2) * sizeof(struct symbol_run));
+    if (scratch == NULL || build.runs == NULL || build.next_runs == NULL)
+    {
+        ERROR_MSG("Can't allocate memory to sort %u symbols.", nr_items);
+        free(scratch);
+        free(build.runs);
+        free(build.next_runs);
+        return -1;
+    }
+    build.src = index->entries;
+    build.dst = scratch;
+    build.nr_runs = nr_chunks;
+    run_build_tasks(nr_chunks, nr_threads, filter_chunk, &build);
+    
+    /* the first round also compacts the runs, there are gaps after filtering */
+    while (build.nr_runs > 1)
+    {
+        uint32_t nr_next = (build.nr_runs + 1) / 2;
+        uint32_t offset = 0;
+        for (uint32_t i = 0; i < nr_next; i++)
+        {
+            build.next_runs[i].offset = offset;
+            build.next_runs[i].count = build.runs[2 * i].count;
+            if (2 * i + 1 < build.nr_runs)
+            {
+                build.next_runs[i].count += build.runs[2 * i + 1].count;
+            }
+            offset += build.next_runs[i].count;
+        }
+        run_build_tasks(nr_next, nr_threads, merge_runs, &build);
+        struct symbol_run *runs = build.runs;
+        build.runs = build.next_runs;
+        build.next_runs = runs;
+        build.nr_runs = nr_next;
+        struct symbol_entry *src = build.src;
+        build.src = build.dst;
+        build.dst = src;
+    }
+    
+    index->nr_entries = build.runs[0].count;
+    if (build.src != index->entries)
+    {
+        memcpy(index->entries, build.src, index->nr_entries * sizeof(struct symbol_entry));
+    }
+    free(scratch);
+    free(build.runs);
+    free(build.next_runs);
+    return 0;
+}
+
+/*
+ * find the symbol containing address, that is the last entry with entry address <= address
+ * the loop has a fixed trip count and the compare compiles into a cmov so there are
+ * no branches to mispredict while walking down the array
+ * returns NULL if address is below the first symbol or past the last one, nothing bounds
+ * the last symbol so whatever is after it can't be said to belong to it
+ */
+const struct symbol_entry *
+symbol_index_lookup(const struct symbol_index *index, uint64_t address)
+{
+    const struct symbol_entry *base = index->entries;
+    uint32_t n = index->nr_entries;
+    
+    if (n == 0 || address < base[0].address)
+    {
+        return NULL;
+    }
+    while (n > 1)
+    {
+        uint32_t half = n / 2;
+        base = (base[half].address <= address) ? base + half : base;
+        n -= half;
+    }
+    if (base == &index->entries[index->nr_entries - 1] && address != base->address)
+    {
+        return NULL;
+    }
+    return base;
+}
+
+/* exact name match, a linear scan so only for the few symbols we look up by name */
+const struct symbol_entry *
+symbol_index_find_name(const struct symbol_index *index, const char *name)
+{
+    size_t len = strlen(name) + 1;
+    for (uint32_t i = 0; i < index->nr_entries; i++)
+    {
+        const struct symbol_entry *entry = &index->entries[i];
+        if (entry->name_off + len <= index->strings_size &&
+            memcmp(index->strings + entry->name_off, name, len) == 0)
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+void
+symbol_index_free(struct symbol_index *index)
+{
+    if (index->map != NULL)
+    {
+        munmap(index->map, index->map_size);
+    }
+    else
+    {
+        free(index->entries);
+    }
+    memset(index, 0, sizeof(struct symbol_index));
+}
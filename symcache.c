@@ -0,0 +1,228 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * symcache.c
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "symcache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#include "hash.h"
+#include "stats.h"
+
+/* local functions */
+static void build_cache_path(const uint8_t *uuid, char *path, size_t path_size);
+static uint64_t cache_checksum(const void *entries, size_t entries_size, const void *strings, size_t strings_size);
+
+static void
+build_cache_path(const uint8_t *uuid, char *path, size_t path_size)
+{
+    char uuid_str[33] = {0};
+    for (int i = 0; i < 16; i++)
+    {
+        snprintf(uuid_str + i * 2, 3, "%02X", uuid[i]);
+    }
+    snprintf(path, path_size, "%s/%s.symcache", SYMCACHE_DIR, uuid_str);
+}
+
+static uint64_t
+cache_checksum(const void *entries, size_t entries_size, const void *strings, size_t strings_size)
+{
+    return hash64(strings, strings_size, hash64(entries, entries_size, SYMCACHE_MAGIC));
+}
+
+/*
+ * map the cache for this kernel and point the index to it
+ * no parsing and no allocation, the index entries live in the read only mapping
+ * returns 0 on success, -1 if there's no valid cache and symbols must be retrieved from the kernel
+ */
+int
+load_symbol_cache(struct symbol_index *index, const uint8_t *uuid, const struct stat *kernel_stat)
+{
+    char path[MAXPATHLEN] = {0};
+    build_cache_path(uuid, path, sizeof(path));
+    
+    int fd = STATS_SYSCALL(open(path, O_RDONLY));
+    if (fd < 0)
+    {
+        DEBUG_MSG("No symbol cache at %s.", path);
+        return -1;
+    }
+    struct stat stat = {0};
+    if (STATS_SYSCALL(fstat(fd, &stat)) < 0 || (size_t)stat.st_size < sizeof(struct symcache_header))
+    {
+        STATS_SYSCALL(close(fd));
+        return -1;
+    }
+    uint8_t *map = STATS_SYSCALL(mmap(0, stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0));
+    /* the mapping stays valid after close */
+    STATS_SYSCALL(close(fd));
+    if (map == MAP_FAILED)
+    {
+        ERROR_MSG("mmap of symbol cache %s failed, %s.", path, strerror(errno));
+        return -1;
+    }
+    
+    const struct symcache_header *header = (const struct symcache_header*)map;
+    uint64_t entries_size = (uint64_t)header->nr_entries * sizeof(struct symbol_entry);
+    if (header->magic != SYMCACHE_MAGIC ||
+        header->version != SYMCACHE_VERSION ||
+        memcmp(header->uuid, uuid, sizeof(header->uuid)) != 0 ||
+        header->kernel_size != (uint64_t)kernel_stat->st_size ||
+        header->kernel_mtime != (int64_t)kernel_stat->st_mtime ||
+        header->entries_offset % sizeof(uint64_t) != 0 ||
+        header->entries_offset + entries_size > (uint64_t)stat.st_size ||
+        header->strings_offset + header->strings_size > (uint64_t)stat.st_size)
+    {
+        DEBUG_MSG("Symbol cache %s is stale, rebuilding.", path);
+        STATS_SYSCALL(munmap(map, stat.st_size));
+        return -1;
+    }
+    if (cache_checksum(map + header->entries_offset, entries_size,
+                       map + header->strings_offset, header->strings_size) != header->checksum)
+    {
+        ERROR_MSG("Symbol cache %s is corrupted, rebuilding.", path);
+        STATS_SYSCALL(munmap(map, stat.st_size));
+        return -1;
+    }
+    
+    memset(index, 0, sizeof(struct symbol_index));
+    index->entries = (struct symbol_entry*)(map + header->entries_offset);
+    index->nr_entries = header->nr_entries;
+    index->capacity = header->nr_entries;
+    index->strings = (const char*)(map + header->strings_offset);
+    index->strings_size = header->strings_size;
+    index->map = map;
+    index->map_size = stat.st_size;
+    DEBUG_MSG("Loaded %u symbols from cache %s.", index->nr_entries, path);
+    return 0;
+}
+
+/*
+ * write the index to the cache, only the strings of indexed symbols are kept
+ * the file is written to a temporary name and renamed so readers never see half a cache
+ */
+int
+save_symbol_cache(const struct symbol_index *index, const uint8_t *uuid, const struct stat *kernel_stat)
+{
+    char path[MAXPATHLEN] = {0};
+    char tmp_path[MAXPATHLEN] = {0};
+    build_cache_path(uuid, path, sizeof(path));
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d", path, getpid());
+    
+    if (STATS_SYSCALL(mkdir(SYMCACHE_DIR, 0755)) < 0 && errno != EEXIST)
+    {
+        DEBUG_MSG("Can't create symbol cache directory %s, %s.", SYMCACHE_DIR, strerror(errno));
+        return -1;
+    }
+    
+    /* repack entries and strings so the cache only holds what we use */
+    size_t entries_size = index->nr_entries * sizeof(struct symbol_entry);
+    size_t strings_size = 0;
+    for (uint32_t i = 0; i < index->nr_entries; i++)
+    {
+        strings_size += strnlen(index->strings + index->entries[i].name_off,
+                                index->strings_size - index->entries[i].name_off) + 1;
+    }
+    size_t total_size = sizeof(struct symcache_header) + entries_size + strings_size;
+    uint8_t *buf = malloc(total_size);
+    if (buf == NULL)
+    {
+        ERROR_MSG("Can't allocate memory for symbol cache.");
+        return -1;
+    }
+    struct symcache_header *header = (struct symcache_header*)buf;
+    struct symbol_entry *entries = (struct symbol_entry*)(buf + sizeof(struct symcache_header));
+    char *strings = (char*)entries + entries_size;
+    
+    uint32_t string_off = 0;
+    for (uint32_t i = 0; i < index->nr_entries; i++)
+    {
+        const char *name = index->strings + index->entries[i].name_off;
+        size_t len = strnlen(name, index->strings_size - index->entries[i].name_off);
+        memcpy(strings + string_off, name, len);
+        strings[string_off + len] = '\0';
+        entries[i].address = index->entries[i].address;
+        entries[i].name_off = string_off;
+        entries[i].reserved = 0;
+        string_off += len + 1;
+    }
+    
+    memset(header, 0, sizeof(struct symcache_header));
+    header->magic = SYMCACHE_MAGIC;
+    header->version = SYMCACHE_VERSION;
+    memcpy(header->uuid, uuid, sizeof(header->uuid));
+    header->kernel_size = kernel_stat->st_size;
+    header->kernel_mtime = kernel_stat->st_mtime;
+    header->nr_entries = index->nr_entries;
+    header->strings_size = (uint32_t)strings_size;
+    header->entries_offset = sizeof(struct symcache_header);
+    header->strings_offset = sizeof(struct symcache_header) + entries_size;
+    header->checksum = cache_checksum(entries, entries_size, strings, strings_size);
+    
+    int ret = -1;
+    int fd = STATS_SYSCALL(open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644));
+    if (fd < 0)
+    {
+        DEBUG_MSG("Can't create symbol cache %s, %s.", tmp_path, strerror(errno));
+        free(buf);
+        return -1;
+    }
+    ssize_t written = STATS_SYSCALL(write(fd, buf, total_size));
+    if (STATS_SYSCALL(close(fd)) == 0 && written == (ssize_t)total_size && STATS_SYSCALL(rename(tmp_path, path)) == 0)
+    {
+        DEBUG_MSG("Saved %u symbols to cache %s.", index->nr_entries, path);
+        ret = 0;
+    }
+    if (ret != 0)
+    {
+        ERROR_MSG("Failed to write symbol cache %s.", path);
+        STATS_SYSCALL(unlink(tmp_path));
+    }
+    free(buf);
+    return ret;
+}
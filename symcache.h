@@ -0,0 +1,76 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * symcache.h
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef checkidt_symcache_h
+#define checkidt_symcache_h
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include "global.h"
+
+#define SYMCACHE_DIR        "/var/db/checkidt"
+#define SYMCACHE_MAGIC      0x48435343  /* CSCH */
+#define SYMCACHE_VERSION    1
+
+/*
+ * on disk symbol cache, one file per kernel UUID
+ * the header is followed by the sorted symbol_entry array and the packed string blob
+ */
+struct symcache_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint8_t uuid[16];
+    uint64_t kernel_size;       /* st_size and st_mtime of the kernel file we were built from */
+    int64_t kernel_mtime;
+    uint32_t nr_entries;
+    uint32_t strings_size;
+    uint64_t entries_offset;
+    uint64_t strings_offset;
+    uint64_t checksum;          /* hash64() of entries and strings */
+};
+
+int load_symbol_cache(struct symbol_index *index, const uint8_t *uuid, const struct stat *kernel_stat);
+int save_symbol_cache(const struct symbol_index *index, const uint8_t *uuid, const struct stat *kernel_stat);
+
+#endif
@@ -0,0 +1,308 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * syscalls.c
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "syscalls.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kernel.h"
+#include "symbols.h"
+#include "textindex.h"
+
+/*
+ * struct sysent and mach_trap_t on 64 bits kernels
+ * Mavericks moved sy_call to the start of sysent and dropped the padding
+ */
+static const struct syscall_layout layouts[] =
+{
+    { 10, 40, 8, 32, 8 },
+    { 11, 40, 8, 32, 8 },
+    { 12, 40, 8, 32, 8 },
+    { 13, 32, 0, 32, 8 },
+};
+
+/* symbols of each table and its entry count */
+static const char *table_symbols[SYSCALL_NR_TABLES][2] =
+{
+    { "_sysent", "_nsysent" },
+    { "_mach_trap_table", "_mach_trap_count" },
+};
+
+static const char *table_names[SYSCALL_NR_TABLES] = { "sysent", "mach_trap_table" };
+
+/* section type for each table in the archive */
+static const uint32_t table_sections[SYSCALL_NR_TABLES] =
+{
+    ARCHIVE_SECTION_SYSENT, ARCHIVE_SECTION_MACH_TRAPS
+};
+
+/* local functions */
+static const struct syscall_layout * get_syscall_layout(int32_t kernel_version);
+static int read_handler_table(struct config *cfg, uint32_t table, const struct syscall_layout *layout, uint8_t *buf, struct handler_table *out);
+static uint32_t check_handler_table(struct config *cfg, const struct handler_table *table);
+static uint32_t compare_handler_table(struct config *cfg, const struct handler_table *table, const uint64_t *saved, uint32_t nr_saved, uint64_t saved_slide);
+
+/* unknown versions (offline images) get the newest layout */
+static const struct syscall_layout *
+get_syscall_layout(int32_t kernel_version)
+{
+    uint32_t nr_layouts = sizeof(layouts) / sizeof(layouts[0]);
+    for (uint32_t i = 0; i < nr_layouts; i++)
+    {
+        if (layouts[i].kernel_version == kernel_version)
+        {
+            return &layouts[i];
+        }
+    }
+    DEBUG_MSG("No syscall table layout for kernel version %d, using the newest.", kernel_version);
+    return &layouts[nr_layouts - 1];
+}
+
+/*
+ * table and count addresses come from the symbols plus the slide
+ * the whole table is read with one readkmem() and the handler pointers extracted from the copy
+ */
+static int
+read_handler_table(struct config *cfg, uint32_t table, const struct syscall_layout *layout, uint8_t *buf, struct handler_table *out)
+{
+    uint32_t entry_size = table == SYSCALL_TABLE_SYSENT ? layout->sysent_size : layout->mach_trap_size;
+    uint32_t handler_off = table == SYSCALL_TABLE_SYSENT ? layout->sysent_handler : layout->mach_trap_handler;
+    
+    memset(out, 0, sizeof(struct handler_table));
+    out->name = table_names[table];
+    const struct symbol_entry *table_symbol = symbol_index_find_name(&cfg->symbols, table_symbols[table][0]);
+    const struct symbol_entry *count_symbol = symbol_index_find_name(&cfg->symbols, table_symbols[table][1]);
+    if (table_symbol == NULL || count_symbol == NULL)
+    {
+        ERROR_MSG("Can't find %s in the kernel symbols.", table_symbol == NULL ? table_symbols[table][0] : table_symbols[table][1]);
+        return -1;
+    }
+    int32_t count = 0;
+    if (readkmem(cfg, &count, count_symbol->address + cfg->kaslr_slide, sizeof(count)) != KERN_SUCCESS)
+    {
+        return -1;
+    }
+    if (count <= 0 || count > SYSCALL_MAX_ENTRIES)
+    {
+        ERROR_MSG("Invalid %s size %d.", out->name, count);
+        return -1;
+    }
+    out->address = table_symbol->address + cfg->kaslr_slide;
+    out->nr_entries = (uint32_t)count;
+    if (readkmem(cfg, buf, out->address, out->nr_entries * entry_size) != KERN_SUCCESS)
+    {
+        ERROR_MSG("Failed to read %s at 0x%llx.", out->name, (unsigned long long)out->address);
+        return -1;
+    }
+    for (uint32_t i = 0; i < out->nr_entries; i++)
+    {
+        memcpy(&out->handlers[i], buf + (size_t)i * entry_size + handler_off, sizeof(uint64_t));
+    }
+    return 0;
+}
+
+int
+read_syscall_tables(struct config *cfg, struct handler_table *tables)
+{
+    const struct syscall_layout *layout = get_syscall_layout(cfg->kernel_version);
+    /* room for the biggest table with the biggest entries */
+    uint8_t *buf = malloc(SYSCALL_MAX_ENTRIES * 40);
+    if (buf == NULL)
+    {
+        ERROR_MSG("Can't allocate memory to read the syscall tables.");
+        memset(tables, 0, SYSCALL_NR_TABLES * sizeof(struct handler_table));
+        return -1;
+    }
+    int ret = 0;
+    for (uint32_t t = 0; t < SYSCALL_NR_TABLES; t++)
+    {
+        if (read_handler_table(cfg, t, layout, buf, &tables[t]) != 0)
+        {
+            ret = -1;
+        }
+    }
+    free(buf);
+    return ret;
+}
+
+/*
+ * archive sections for the tables, the payloads point into tables so it must outlive them
+ * returns the number of payloads, tables that can't be read are left out
+ */
+uint32_t
+get_syscall_payloads(struct config *cfg, struct handler_table *tables, struct archive_payload *payloads)
+{
+    uint32_t nr_payloads = 0;
+    read_syscall_tables(cfg, tables);
+    for (uint32_t t = 0; t < SYSCALL_NR_TABLES; t++)
+    {
+        if (tables[t].nr_entries == 0)
+        {
+            continue;
+        }
+        payloads[nr_payloads].type = table_sections[t];
+        payloads[nr_payloads].entry_size = sizeof(uint64_t);
+        payloads[nr_payloads].nr_entries = tables[t].nr_entries;
+        payloads[nr_payloads].data = tables[t].handlers;
+        nr_payloads++;
+    }
+    return nr_payloads;
+}
+
+/* every handler must be kernel text, report the ones that aren't */
+static uint32_t
+check_handler_table(struct config *cfg, const struct handler_table *table)
+{
+    uint64_t outside[SYSCALL_MAX_ENTRIES / 64];
+    if (cfg->text.nr_ranges == 0)
+    {
+        return 0;
+    }
+    uint32_t nr_outside = text_index_validate(&cfg->text, cfg->kaslr_slide, table->handlers, table->nr_entries, outside);
+    for (uint32_t i = 0; i < table->nr_entries && nr_outside > 0; i++)
+    {
+        if (((outside[i / 64] >> (i % 64)) & 1) == 0)
+        {
+            continue;
+        }
+        char name[256] = {0};
+        resolve_symbol(cfg, table->handlers[i], name, sizeof(name));
+        ERROR_MSG("%s entry %u handler 0x%llx %s is outside kernel text!!!", table->name, i,
+                  (unsigned long long)table->handlers[i], name);
+    }
+    return nr_outside;
+}
+
+/* handlers are compared without the slide so archives from other boots still match */
+static uint32_t
+compare_handler_table(struct config *cfg, const struct handler_table *table, const uint64_t *saved, uint32_t nr_saved, uint64_t saved_slide)
+{
+    uint32_t nr_changed = 0;
+    if (nr_saved != table->nr_entries)
+    {
+        ERROR_MSG("%s has %u entries but the archive has %u.", table->name, table->nr_entries, nr_saved);
+        nr_changed++;
+    }
+    uint32_t nr_entries = MIN(nr_saved, table->nr_entries);
+    for (uint32_t i = 0; i < nr_entries; i++)
+    {
+        uint64_t old_handler = saved[i] - saved_slide;
+        uint64_t new_handler = table->handlers[i] - cfg->kaslr_slide;
+        if (old_handler == new_handler)
+        {
+            continue;
+        }
+        char old_name[256] = {0}, new_name[256] = {0};
+        resolve_symbol(cfg, saved[i] - saved_slide + cfg->kaslr_slide, old_name, sizeof(old_name));
+        resolve_symbol(cfg, table->handlers[i], new_name, sizeof(new_name));
+        ERROR_MSG("Hey %s entry %u has changed!!! %s (0x%llx) -> %s (0x%llx)", table->name, i,
+                  old_name, (unsigned long long)saved[i], new_name, (unsigned long long)table->handlers[i]);
+        nr_changed++;
+    }
+    return nr_changed;
+}
+
+/*
+ * read sysent and mach_trap_table, check every handler is kernel text
+ * and if we are comparing diff them against the archive
+ * returns 0 if everything is fine, 1 if something is wrong, -1 on errors
+ */
+int
+check_syscall_tables(struct config *cfg)
+{
+    struct idt_archive archive = {0};
+    uint32_t nr_bad = 0;
+    
+    if (cfg->symbols.nr_entries == 0)
+    {
+        ERROR_MSG("Syscall tables are found with the kernel symbols, use -k.");
+        return -1;
+    }
+    struct handler_table *tables = calloc(SYSCALL_NR_TABLES, sizeof(struct handler_table));
+    if (tables == NULL)
+    {
+        ERROR_MSG("Can't allocate memory for the syscall tables.");
+        return -1;
+    }
+    int ret = read_syscall_tables(cfg, tables);
+    int have_archive = (cfg->compare_idt == 1 && open_idt_archive(cfg->in_filename, &archive) == 0);
+    for (uint32_t t = 0; t < SYSCALL_NR_TABLES; t++)
+    {
+        if (tables[t].nr_entries == 0)
+        {
+            continue;
+        }
+        uint32_t nr_bad_table = check_handler_table(cfg, &tables[t]);
+        if (have_archive)
+        {
+            uint32_t nr_saved = 0;
+            const uint64_t *saved = get_archive_section(&archive, table_sections[t], &nr_saved);
+            if (saved != NULL)
+            {
+                nr_bad_table += compare_handler_table(cfg, &tables[t], saved, nr_saved, archive.kaslr_slide);
+            }
+            else
+            {
+                ERROR_MSG("Archive has no %s, nothing to compare with.", tables[t].name);
+            }
+        }
+        if (nr_bad_table == 0 && cfg->output_format == OUTPUT_FORMAT_TABLE)
+        {
+            OUTPUT_MSG("[OK] All %u %s handlers are fine.", tables[t].nr_entries, tables[t].name);
+        }
+        nr_bad += nr_bad_table;
+    }
+    if (have_archive)
+    {
+        close_idt_archive(&archive);
+    }
+    free(tables);
+    if (ret != 0)
+    {
+        return -1;
+    }
+    return nr_bad == 0 ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * syscalls.h
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef checkidt_syscalls_h
+#define checkidt_syscalls_h
+
+#include <stdint.h>
+#include "global.h"
+#include "archive.h"
+
+#define SYSCALL_MAX_ENTRIES     1024
+#define SYSCALL_NR_TABLES       2
+
+/* which table */
+#define SYSCALL_TABLE_SYSENT        0
+#define SYSCALL_TABLE_MACH_TRAPS    1
+
+/* where the handler pointer is inside each table entry for a kernel version */
+struct syscall_layout
+{
+    int32_t kernel_version;
+    uint32_t sysent_size;
+    uint32_t sysent_handler;
+    uint32_t mach_trap_size;
+    uint32_t mach_trap_handler;
+};
+
+/* a table as read from kernel memory, only the handler pointers are kept */
+struct handler_table
+{
+    const char *name;
+    mach_vm_address_t address;      /* slid */
+    uint64_t handlers[SYSCALL_MAX_ENTRIES];
+    uint32_t nr_entries;
+};
+
+int read_syscall_tables(struct config *cfg, struct handler_table *tables);
+uint32_t get_syscall_payloads(struct config *cfg, struct handler_table *tables, struct archive_payload *payloads);
+int check_syscall_tables(struct config *cfg);
+
+#endif
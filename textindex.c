@@ -0,0 +1,126 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * textindex.c
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "textindex.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void
+text_index_init(struct text_index *index)
+{
+    memset(index, 0, sizeof(struct text_index));
+}
+
+/* ranges can be added in any order, call text_index_finalize() before using the index */
+int
+text_index_add(struct text_index *index, uint64_t start, uint64_t size)
+{
+    if (size == 0 || start + size < start)
+    {
+        return -1;
+    }
+    if (index->nr_ranges >= TEXT_MAX_RANGES)
+    {
+        ERROR_MSG("Too many executable ranges, ignoring 0x%llx.", (unsigned long long)start);
+        return -1;
+    }
+    index->start[index->nr_ranges] = start;
+    index->end[index->nr_ranges] = start + size;
+    index->nr_ranges++;
+    return 0;
+}
+
+/* sort by start and merge overlapping or adjacent ranges, there are only a handful */
+void
+text_index_finalize(struct text_index *index)
+{
+    for (uint32_t i = 1; i < index->nr_ranges; i++)
+    {
+        uint64_t start = index->start[i];
+        uint64_t end = index->end[i];
+        uint32_t j = i;
+        while (j > 0 && index->start[j - 1] > start)
+        {
+            index->start[j] = index->start[j - 1];
+            index->end[j] = index->end[j - 1];
+            j--;
+        }
+        index->start[j] = start;
+        index->end[j] = end;
+    }
+    uint32_t nr_merged = 0;
+    for (uint32_t i = 0; i < index->nr_ranges; i++)
+    {
+        if (nr_merged > 0 && index->start[i] <= index->end[nr_merged - 1])
+        {
+            index->end[nr_merged - 1] = MAX(index->end[nr_merged - 1], index->end[i]);
+            continue;
+        }
+        index->start[nr_merged] = index->start[i];
+        index->end[nr_merged] = index->end[i];
+        nr_merged++;
+    }
+    index->nr_ranges = nr_merged;
+}
+
+/*
+ * check count slid addresses against the unslid ranges
+ * bit i of outside is set if addresses[i] isn't kernel text, zero addresses are skipped
+ * (unused entries), outside needs room for (count + 63) / 64 words
+ * returns the number of addresses outside
+ */
+uint32_t
+text_index_validate(const struct text_index *index, uint64_t slide, const uint64_t *addresses, uint32_t count, uint64_t *outside)
+{
+    uint32_t nr_outside = 0;
+    memset(outside, 0, ((count + 63) / 64) * sizeof(uint64_t));
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint64_t bad = (addresses[i] != 0) & !text_index_contains(index, addresses[i] - slide);
+        outside[i / 64] |= bad << (i % 64);
+        nr_outside += (uint32_t)bad;
+    }
+    return nr_outside;
+}
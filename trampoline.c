@@ -0,0 +1,333 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * trampoline.c
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "trampoline.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "idt.h"
+#include "kernel.h"
+#include "insn.h"
+#include "fingerprint.h"
+#include "textindex.h"
+#include "timer.h"
+
+/* local functions */
+static const uint8_t * fetch_code(struct config *cfg, mach_vm_address_t address, uint8_t *buf, size_t size);
+static int leaves_text(struct config *cfg, uint64_t target, struct handler_trace *trace, uint8_t via);
+static void trace_handler(struct config *cfg, uint64_t address, const uint8_t *code, size_t size, struct handler_trace *trace);
+static const char * get_via_name(uint8_t via);
+
+static const char *
+get_via_name(uint8_t via)
+{
+    static const char *names[] = { "", "jmp", "jcc", "call", "push/ret", "jmp through register", "jmp through memory" };
+    return via < sizeof(names) / sizeof(names[0]) ? names[via] : "";
+}
+
+/* in place if the source can map memory, else a read into buf */
+static const uint8_t *
+fetch_code(struct config *cfg, mach_vm_address_t address, uint8_t *buf, size_t size)
+{
+    const uint8_t *data = mapkmem(cfg, address, size);
+    if (data == NULL && readkmem(cfg, buf, address, (int)size) == KERN_SUCCESS)
+    {
+        data = buf;
+    }
+    return data;
+}
+
+static int
+leaves_text(struct config *cfg, uint64_t target, struct handler_trace *trace, uint8_t via)
+{
+    if (text_index_contains(&cfg->text, target - cfg->kaslr_slide))
+    {
+        return 0;
+    }
+    trace->status = TRACE_OUTSIDE;
+    trace->target = target;
+    trace->via = via;
+    return 1;
+}
+
+/*
+ * follow the first instructions of a handler and stop at the first branch that leaves text
+ * direct jumps inside text are followed, calls and conditional branches only checked
+ * push/ret and mov/jmp register pairs and rip relative indirect jumps are resolved too,
+ * those are the usual ways to plant a trampoline over a legitimate stub
+ */
+static void
+trace_handler(struct config *cfg, uint64_t address, const uint8_t *code, size_t size, struct handler_trace *trace)
+{
+    uint8_t buf[TRAMPOLINE_WINDOW];
+    uint64_t base = address;
+    uint64_t pc = address;
+    uint64_t pushed = 0;
+    int push_valid = 0;
+    uint64_t registers[16] = {0};
+    uint16_t registers_valid = 0;
+    uint32_t hops = 0;
+    struct insn insn;
+    
+    memset(trace, 0, sizeof(struct handler_trace));
+    trace->address = address;
+    while (trace->nr_insns < TRAMPOLINE_MAX_INSNS)
+    {
+        /* refill the window when the next instruction might not fit */
+        if (code == NULL || pc - base + INSN_MAX_LENGTH > size)
+        {
+            base = pc;
+            size = TRAMPOLINE_WINDOW;
+            code = fetch_code(cfg, pc, buf, size);
+            if (code == NULL)
+            {
+                trace->status = trace->nr_insns == 0 ? TRACE_UNREADABLE : TRACE_CLEAN;
+                return;
+            }
+        }
+        if (insn_decode(code + (pc - base), size - (pc - base), &insn) == 0)
+        {
+            trace->status = TRACE_UNDECODABLE;
+            return;
+        }
+        trace->nr_insns++;
+        uint64_t next = pc + insn.length;
+        /* a push only turns the ret into a jump when they are next to each other */
+        int after_push = push_valid;
+        push_valid = 0;
+        switch (insn.kind)
+        {
+            case INSN_JMP:
+                if (leaves_text(cfg, insn_branch_target(pc, &insn), trace, TRACE_VIA_JMP) || ++hops > TRAMPOLINE_MAX_HOPS)
+                {
+                    return;
+                }
+                next = insn_branch_target(pc, &insn);
+                code = NULL;
+                break;
+            case INSN_JCC:
+            case INSN_CALL:
+                if (leaves_text(cfg, insn_branch_target(pc, &insn), trace, insn.kind == INSN_JCC ? TRACE_VIA_JCC : TRACE_VIA_CALL))
+                {
+                    return;
+                }
+                break;
+            case INSN_PUSH_IMM:
+                pushed = (uint64_t)insn.imm;
+                push_valid = 1;
+                break;
+            case INSN_MOV_IMM64:
+                registers[insn.reg] = (uint64_t)insn.imm;
+                registers_valid |= 1 << insn.reg;
+                break;
+            case INSN_RET:
+                if (after_push)
+                {
+                    leaves_text(cfg, pushed, trace, TRACE_VIA_PUSH_RET);
+                }
+                return;
+            case INSN_JMP_INDIRECT:
+            case INSN_CALL_INDIRECT:
+            {
+                uint64_t target = 0;
+                uint8_t via = TRACE_VIA_NONE;
+                if (insn.reg != INSN_NO_REG && (registers_valid >> insn.reg) & 1)
+                {
+                    target = registers[insn.reg];
+                    via = TRACE_VIA_REGISTER;
+                }
+                else if (insn.reg == INSN_NO_REG && insn.rip_relative && readkmem(cfg, &target, next + insn.disp, sizeof(target)) == KERN_SUCCESS)
+                {
+                    via = TRACE_VIA_MEMORY;
+                }
+                if ((via != TRACE_VIA_NONE && leaves_text(cfg, target, trace, via)) || insn.kind == INSN_JMP_INDIRECT)
+                {
+                    return;
+                }
+                break;
+            }
+            case INSN_TRAP:
+                return;
+            default:
+                break;
+        }
+        pc = next;
+    }
+}
+
+/*
+ * trace every present handler of a decoded table
+ * handlers are traced once per distinct address and the first windows are read with the
+ * same coalescing as the fingerprints, so a table costs a few reads and microseconds of decoding
+ * returns the number of handlers that leave kernel text
+ */
+uint32_t
+trace_idt_handlers(struct config *cfg, const struct idt_model *model, struct idt_traces *traces)
+{
+    uint64_t *stubs = traces->stubs;
+    mach_vm_address_t *addresses = traces->addresses;
+    struct handler_trace *unique = traces->unique;
+    
+    /* only the results, the scratch is overwritten below */
+    memset(traces->entries, 0, sizeof(traces->entries));
+    memset(traces->outside, 0, sizeof(traces->outside));
+    traces->nr_outside = 0;
+    traces->nr_insns = 0;
+    for (uint32_t x = 0; x < model->nr_entries; x++)
+    {
+        stubs[x] = model->present[x] ? model->stub[x] : 0;
+    }
+    uint32_t count = collect_stub_addresses(stubs, model->nr_entries, addresses);
+    uint32_t i = 0;
+    while (i < count)
+    {
+        mach_vm_address_t start = addresses[i];
+        mach_vm_address_t end = start + TRAMPOLINE_WINDOW;
+        uint32_t j = i + 1;
+        while (j < count &&
+               addresses[j] <= end + FINGERPRINT_MAX_GAP &&
+               addresses[j] + TRAMPOLINE_WINDOW - start <= FINGERPRINT_MAX_READ)
+        {
+            end = addresses[j] + TRAMPOLINE_WINDOW;
+            j++;
+        }
+        const uint8_t *data = fetch_code(cfg, start, traces->buf, end - start);
+        for (uint32_t k = i; k < j; k++)
+        {
+            /* a failed coalesced read leaves each handler to read its own window */
+            trace_handler(cfg, addresses[k], data != NULL ? data + (addresses[k] - start) : NULL, end - addresses[k], &unique[k]);
+            traces->nr_insns += unique[k].nr_insns;
+        }
+        i = j;
+    }
+    
+    for (uint32_t x = 0; x < model->nr_entries; x++)
+    {
+        if (stubs[x] == 0)
+        {
+            continue;
+        }
+        /* addresses are sorted and unique */
+        uint32_t lo = 0, hi = count;
+        while (hi - lo > 1)
+        {
+            uint32_t mid = (lo + hi) / 2;
+            lo = addresses[mid] <= stubs[x] ? mid : lo;
+            hi = addresses[mid] <= stubs[x] ? hi : mid;
+        }
+        traces->entries[x] = unique[lo];
+        if (unique[lo].status == TRACE_OUTSIDE)
+        {
+            traces->outside[x / 64] |= 1ULL << (x % 64);
+            traces->nr_outside++;
+        }
+    }
+    return traces->nr_outside;
+}
+
+void
+report_idt_traces(struct config *cfg, const struct idt_model *model, const struct idt_traces *traces)
+{
+    char name[256] = {0};
+    char target_name[256] = {0};
+    for (uint32_t x = 0; x < model->nr_entries; x++)
+    {
+        const struct handler_trace *trace = &traces->entries[x];
+        if (trace->status != TRACE_OUTSIDE)
+        {
+            continue;
+        }
+        /* the kernel symbols are always loaded for the text ranges */
+        if (resolve_symbol(cfg, trace->address, name, sizeof(name)) != 0)
+        {
+            name[0] = '\0';
+        }
+        if (resolve_symbol(cfg, trace->target, target_name, sizeof(target_name)) != 0)
+        {
+            target_name[0] = '\0';
+        }
+        ERROR_MSG("Handler of interrupt 0x%x at 0x%llx%s%s leaves kernel text with a %s to 0x%llx%s%s!!!", x,
+                  (unsigned long long)trace->address, name[0] != '\0' ? " " : "", name, get_via_name(trace->via),
+                  (unsigned long long)trace->target, target_name[0] != '\0' ? " " : "", target_name);
+    }
+}
+
+/* --trampolines, follow every handler and report code that branches out of kernel text */
+int
+check_idt_trampolines(struct config *cfg)
+{
+    struct idt_snapshot snapshot = {0};
+    struct idt_model model = {0};
+    
+    if (cfg->text.nr_ranges == 0)
+    {
+        ERROR_MSG("No kernel text ranges, they are read from the kernel file with -k.");
+        return -1;
+    }
+    if (read_idt_snapshot(cfg, &snapshot) != KERN_SUCCESS)
+    {
+        return -1;
+    }
+    /* the traces carry a coalesced read buffer, too big for the stack */
+    struct idt_traces *traces = malloc(sizeof(struct idt_traces));
+    if (traces == NULL)
+    {
+        ERROR_MSG("Can't allocate memory to trace the handlers.");
+        return -1;
+    }
+    decode_idt(snapshot.descriptors, snapshot.nr_entries, cfg->kernel_type, &model);
+    uint64_t start = monotonic_ns();
+    uint32_t nr_outside = trace_idt_handlers(cfg, &model, traces);
+    uint64_t elapsed = monotonic_ns() - start;
+    report_idt_traces(cfg, &model, traces);
+    if (nr_outside == 0 && cfg->output_format == OUTPUT_FORMAT_TABLE)
+    {
+        OUTPUT_MSG("[OK] No handler branches out of kernel text (%u instructions traced in %.1f us).",
+                   traces->nr_insns, elapsed / 1000.0);
+    }
+    free(traces);
+    return nr_outside == 0 ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * trampoline.h
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef checkidt_trampoline_h
+#define checkidt_trampoline_h
+
+#include <stdint.h>
+#include "global.h"
+#include "diff.h"
+#include "decode.h"
+#include "fingerprint.h"
+
+#define TRAMPOLINE_MAX_INSNS    16      /* instructions followed from each handler */
+#define TRAMPOLINE_MAX_HOPS     4       /* direct jumps followed inside kernel text */
+#define TRAMPOLINE_WINDOW       64      /* bytes read from each handler and each jump target */
+
+/* handler_trace status */
+#define TRACE_CLEAN             0
+#define TRACE_OUTSIDE           1       /* a branch leaves kernel text */
+#define TRACE_UNREADABLE        2
+#define TRACE_UNDECODABLE       3       /* invalid instruction before any branch */
+
+/* how the code left kernel text */
+#define TRACE_VIA_NONE          0
+#define TRACE_VIA_JMP           1
+#define TRACE_VIA_JCC           2
+#define TRACE_VIA_CALL          3
+#define TRACE_VIA_PUSH_RET      4       /* push imm32; ret */
+#define TRACE_VIA_REGISTER      5       /* mov reg, imm64; jmp/call reg */
+#define TRACE_VIA_MEMORY        6       /* jmp/call [rip + disp] */
+
+struct handler_trace
+{
+    uint64_t address;
+    uint64_t target;        /* where it left kernel text */
+    uint32_t nr_insns;
+    uint8_t status;         /* TRACE_* */
+    uint8_t via;            /* TRACE_VIA_* */
+};
+
+/* traces of a whole table, indexed by interrupt */
+struct idt_traces
+{
+    struct handler_trace entries[IDT_MAX_ENTRIES];
+    uint64_t outside[DIFF_BITMAP_WORDS];
+    uint32_t nr_outside;
+    uint32_t nr_insns;
+    /* scratch for trace_idt_handlers, owned by the caller so tracing is reentrant */
+    uint64_t stubs[IDT_MAX_ENTRIES];
+    mach_vm_address_t addresses[IDT_MAX_ENTRIES];
+    struct handler_trace unique[IDT_MAX_ENTRIES];
+    uint8_t buf[FINGERPRINT_MAX_READ];
+};
+
+uint32_t trace_idt_handlers(struct config *cfg, const struct idt_model *model, struct idt_traces *traces);
+void report_idt_traces(struct config *cfg, const struct idt_model *model, const struct idt_traces *traces);
+int check_idt_trampolines(struct config *cfg);
+
+#endif
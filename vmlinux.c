@@ -0,0 +1,272 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * vmlinux.c
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "vmlinux.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "elf64.h"
+#include "symbols.h"
+#include "symcache.h"
+#include "textindex.h"
+#include "stats.h"
+
+/* what filter_elf_symbols() works on */
+struct elf_symbol_filter
+{
+    const Elf64_Sym *symbols;
+    uint32_t strsize;
+};
+
+/* local functions */
+static int get_section_headers(const uint8_t *map, size_t size, const Elf64_Shdr **sections, uint32_t *nr_sections);
+static int find_build_id(const uint8_t *map, size_t size, const Elf64_Shdr *sections, uint32_t nr_sections, uint8_t *uuid);
+static uint32_t filter_elf_symbols(const void *context, uint32_t begin, uint32_t end, struct symbol_entry *out);
+
+/*
+ * the section headers of a 64 bits ELF file, everything is checked against the file size
+ * because we work straight on the mapped file
+ */
+static int
+get_section_headers(const uint8_t *map, size_t size, const Elf64_Shdr **sections, uint32_t *nr_sections)
+{
+    const Elf64_Ehdr *ehdr = (const Elf64_Ehdr*)map;
+    if (size < sizeof(Elf64_Ehdr) || memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 || ehdr->e_ident[EI_CLASS] != ELFCLASS64)
+    {
+        ERROR_MSG("Not a 64 bits ELF file.");
+        return -1;
+    }
+    if (ehdr->e_type != ET_EXEC && ehdr->e_type != ET_DYN)
+    {
+        ERROR_MSG("ELF file type %d isn't a kernel image.", ehdr->e_type);
+        return -1;
+    }
+    if (ehdr->e_shnum == 0 || ehdr->e_shentsize != sizeof(Elf64_Shdr) ||
+        ehdr->e_shoff > size || (size - ehdr->e_shoff) / sizeof(Elf64_Shdr) < ehdr->e_shnum)
+    {
+        ERROR_MSG("Invalid ELF section headers, is the file stripped or truncated?");
+        return -1;
+    }
+    *sections = (const Elf64_Shdr*)(map + ehdr->e_shoff);
+    *nr_sections = ehdr->e_shnum;
+    return 0;
+}
+
+/*
+ * the GNU build id plays the role of the Mach-O LC_UUID for the symbol cache
+ * it's 20 bytes of SHA1 in kernel builds, the first 16 are plenty to tell kernels apart
+ */
+static int
+find_build_id(const uint8_t *map, size_t size, const Elf64_Shdr *sections, uint32_t nr_sections, uint8_t *uuid)
+{
+    for (uint32_t i = 0; i < nr_sections; i++)
+    {
+        const Elf64_Shdr *shdr = &sections[i];
+        if (shdr->sh_type != SHT_NOTE || shdr->sh_offset > size || shdr->sh_size > size - shdr->sh_offset)
+        {
+            continue;
+        }
+        const uint8_t *note = map + shdr->sh_offset;
+        const uint8_t *end = note + shdr->sh_size;
+        while ((size_t)(end - note) >= sizeof(Elf64_Nhdr))
+        {
+            const Elf64_Nhdr *nhdr = (const Elf64_Nhdr*)note;
+            /* name and descriptor are padded to 4 bytes */
+            uint64_t name_size = ((uint64_t)nhdr->n_namesz + 3) & ~3ULL;
+            uint64_t desc_size = ((uint64_t)nhdr->n_descsz + 3) & ~3ULL;
+            if (name_size + desc_size > (uint64_t)(end - note) - sizeof(Elf64_Nhdr))
+            {
+                break;
+            }
+            const uint8_t *name = note + sizeof(Elf64_Nhdr);
+            if (nhdr->n_type == NT_GNU_BUILD_ID && nhdr->n_namesz == 4 && memcmp(name, "GNU", 4) == 0 && nhdr->n_descsz >= 16)
+            {
+                memcpy(uuid, name + name_size, 16);
+                return 0;
+            }
+            note += sizeof(Elf64_Nhdr) + name_size + desc_size;
+        }
+    }
+    return -1;
+}
+
+/*
+ * keep the symbols that can be resolved to, undefined and absolute symbols, section and file
+ * names and anything without an address or a valid name are filtered out
+ * only reads the mapped symbol table so chunks can run on any thread
+ */
+static uint32_t
+filter_elf_symbols(const void *context, uint32_t begin, uint32_t end, struct symbol_entry *out)
+{
+    const struct elf_symbol_filter *filter = context;
+    const Elf64_Sym *symbols = filter->symbols;
+    uint32_t count = 0;
+    for (uint32_t i = begin; i < end; i++)
+    {
+        uint8_t type = ELF64_ST_TYPE(symbols[i].st_info);
+        if (symbols[i].st_shndx == SHN_UNDEF || symbols[i].st_shndx == SHN_ABS ||
+            type == STT_SECTION || type == STT_FILE ||
+            symbols[i].st_value == 0 || symbols[i].st_name == 0 || symbols[i].st_name >= filter->strsize)
+        {
+            continue;
+        }
+        out[count].address = symbols[i].st_value;
+        out[count].name_off = symbols[i].st_name;
+        out[count].reserved = 0;
+        count++;
+    }
+    return count;
+}
+
+/*
+ * build the symbol index from an uncompressed vmlinux with its .symtab
+ * the file is mapped, the executable sections become the text ranges and the symbols are
+ * filtered and sorted in parallel chunks by symbol_index_build()
+ * vmlinux addresses are the link addresses so no slide is removed, same as the Mach-O loader
+ */
+int
+load_vmlinux_symbols(struct config *cfg)
+{
+    int fd = STATS_SYSCALL(open(cfg->kernel_filename, O_RDONLY));
+    if (fd < 0)
+    {
+        ERROR_MSG("Failed to open %s, %s.", cfg->kernel_filename, strerror(errno));
+        return -1;
+    }
+    struct stat stat = {0};
+    if (STATS_SYSCALL(fstat(fd, &stat)) < 0 || stat.st_size <= 0)
+    {
+        ERROR_MSG("Can't fstat %s, %s.", cfg->kernel_filename, strerror(errno));
+        STATS_SYSCALL(close(fd));
+        return -1;
+    }
+    size_t size = (size_t)stat.st_size;
+    uint8_t *map = STATS_SYSCALL(mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0));
+    STATS_SYSCALL(close(fd));
+    if (map == MAP_FAILED)
+    {
+        ERROR_MSG("mmap of %s failed, %s.", cfg->kernel_filename, strerror(errno));
+        return -1;
+    }
+    
+    const Elf64_Shdr *sections = NULL;
+    uint32_t nr_sections = 0;
+    if (get_section_headers(map, size, &sections, &nr_sections) != 0)
+    {
+        STATS_SYSCALL(munmap(map, size));
+        return -1;
+    }
+    const Elf64_Shdr *symtab = NULL;
+    text_index_init(&cfg->text);
+    for (uint32_t i = 0; i < nr_sections; i++)
+    {
+        if (sections[i].sh_type == SHT_SYMTAB && symtab == NULL)
+        {
+            symtab = &sections[i];
+        }
+        if ((sections[i].sh_flags & (SHF_ALLOC | SHF_EXECINSTR)) == (SHF_ALLOC | SHF_EXECINSTR) &&
+            sections[i].sh_addr != 0 && sections[i].sh_size != 0)
+        {
+            text_index_add(&cfg->text, sections[i].sh_addr, sections[i].sh_size);
+        }
+    }
+    text_index_finalize(&cfg->text);
+    
+    const Elf64_Shdr *strtab = symtab != NULL && symtab->sh_link < nr_sections ? &sections[symtab->sh_link] : NULL;
+    if (symtab == NULL || strtab == NULL || strtab->sh_type != SHT_STRTAB ||
+        symtab->sh_offset > size || symtab->sh_size > size - symtab->sh_offset ||
+        strtab->sh_offset > size || strtab->sh_size > size - strtab->sh_offset ||
+        symtab->sh_size / sizeof(Elf64_Sym) >= UINT32_MAX || strtab->sh_size >= UINT32_MAX)
+    {
+        ERROR_MSG("No usable symbol table in %s, it needs an unstripped vmlinux.", cfg->kernel_filename);
+        STATS_SYSCALL(munmap(map, size));
+        return -1;
+    }
+    
+    /* a valid cache for this kernel saves us from processing all the symbols */
+    uint8_t uuid[16] = {0};
+    int has_uuid = find_build_id(map, size, sections, nr_sections, uuid) == 0;
+    if (has_uuid && load_symbol_cache(&cfg->symbols, uuid, &stat) == 0)
+    {
+        stats_add(STATS_SYMBOL_CACHE_HITS, 1);
+        STATS_SYSCALL(munmap(map, size));
+        return 0;
+    }
+    
+    uint32_t nsyms = (uint32_t)(symtab->sh_size / sizeof(Elf64_Sym));
+    uint32_t strsize = (uint32_t)strtab->sh_size;
+    char *strings = NULL;
+    if (symbol_index_init(&cfg->symbols, nsyms, strsize + 1, &strings) != 0)
+    {
+        STATS_SYSCALL(munmap(map, size));
+        return -1;
+    }
+    /* the table should end with a NUL but the last name is safe even if it doesn't */
+    memcpy(strings, map + strtab->sh_offset, strsize);
+    strings[strsize] = '\0';
+    
+    struct elf_symbol_filter filter = { (const Elf64_Sym*)(map + symtab->sh_offset), strsize };
+    int ret = symbol_index_build(&cfg->symbols, nsyms, filter_elf_symbols, &filter, cfg->nr_threads);
+    STATS_SYSCALL(munmap(map, size));
+    if (ret != 0)
+    {
+        symbol_index_free(&cfg->symbols);
+        return -1;
+    }
+    DEBUG_MSG("Loaded %u symbols from %s.", cfg->symbols.nr_entries, cfg->kernel_filename);
+    
+    /* save the cache for next runs */
+    if (has_uuid)
+    {
+        save_symbol_cache(&cfg->symbols, uuid, &stat);
+    }
+    return 0;
+}
@@ -0,0 +1,321 @@
+/*
+ *  _______  __                  __     ___  ______    _______
+ * |   _   ||  |--..-----..----.|  |--.|   ||   _  \  |       |
+ * |.  1___||     ||  -__||  __||    < |.  ||.  |   \ |.|   | |
+ * |.  |___ |__|__||_____||____||__|__||.  ||.  |    \`-|.  |-'
+ * |:  1   |                           |:  ||:  1    /  |:  |
+ * |::.. . |                           |::.||::.. . /   |::.|
+ * `-------'                           `---'`------'    `---'
+ *
+ * CheckIDT - OS X version
+ *
+ * Based on kad's original code at Phrack #59
+ * http://www.phrack.org/issues.html?issue=59&id=4#article
+ *
+ * (c) fG!, 2011, 2012, 2013, 2014 - reverser@put.as - http://reverse.put.as
+ *
+ * watch.c
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "watch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+
+#include "idt.h"
+#include "kernel.h"
+#include "archive.h"
+#include "timer.h"
+#include "diff.h"
+#include "decode.h"
+#include "history.h"
+#include "trampoline.h"
+#include "output.h"
+
+/* everything the loop touches is allocated here once */
+struct watch_state
+{
+    struct idt_snapshot baseline;
+    struct idt_snapshot last;
+    struct idt_snapshot current;
+    struct idt_diff diff;
+    struct idt_model last_model;
+    struct idt_model current_model;
+    struct idt_traces traces;
+    uint64_t last_outside[DIFF_BITMAP_WORDS];   /* handlers that left text at the previous scan */
+    struct history history;
+    int recording;          /* appending scans to --history */
+    int detected;           /* something changed during the session */
+    uint64_t scans;
+    uint64_t total_ns;
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint64_t report_scans;
+    uint64_t report_ns;
+};
+
+/* local functions */
+static void stop_handler(int sig);
+static void report_changes(struct config *cfg, struct watch_state *state);
+static void report_timing(struct config *cfg, struct watch_state *state);
+static void sleep_until(uint64_t deadline);
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void
+stop_handler(int sig)
+{
+    (void)sig;
+    g_stop = 1;
+}
+
+/* sleep until the monotonic deadline so scan time doesn't drift the interval */
+static void
+sleep_until(uint64_t deadline)
+{
+    uint64_t now = monotonic_ns();
+    if (now >= deadline)
+    {
+        return;
+    }
+    uint64_t delta = deadline - now;
+    struct timespec ts = { .tv_sec = delta / 1000000000ULL, .tv_nsec = delta % 1000000000ULL };
+    /* a signal wakes us up early, that's fine since the loop checks g_stop */
+    nanosleep(&ts, NULL);
+}
+
+/* report entries that changed since the previous scan and if they still match the baseline */
+static void
+report_changes(struct config *cfg, struct watch_state *state)
+{
+    char name[256] = {0};
+    decode_idt(state->last.descriptors, state->last.nr_entries, cfg->kernel_type, &state->last_model);
+    decode_idt(state->current.descriptors, state->current.nr_entries, cfg->kernel_type, &state->current_model);
+    for (uint32_t x = 0; x < state->current.nr_entries; x++)
+    {
+        if (diff_entry_changed(&state->diff, x) == 0)
+        {
+            continue;
+        }
+        mach_vm_address_t old_addr = state->last_model.stub[x];
+        mach_vm_address_t new_addr = state->current_model.stub[x];
+        int restored = memcmp(&state->current.descriptors[x], &state->baseline.descriptors[x], sizeof(struct descriptor_idt)) == 0;
+        if (cfg->resolve == 1)
+        {
+            resolve_symbol(cfg, new_addr, name, sizeof(name));
+        }
+        ERROR_MSG("Scan %llu: interrupt 0x%x changed 0x%llx -> 0x%llx %s%s",
+                  (unsigned long long)state->scans, x,
+                  (unsigned long long)old_addr, (unsigned long long)new_addr,
+                  cfg->resolve == 1 ? name : "",
+                  restored ? " (back to baseline)" : "");
+        if (cfg->output_format != OUTPUT_FORMAT_TABLE)
+        {
+            struct output_entry entry = {0};
+            entry.interrupt = x;
+            entry.stub = new_addr;
+            entry.old_stub = old_addr;
+            entry.selector = state->current_model.selector[x];
+            entry.dpl = state->current_model.dpl[x];
+            entry.type = state->current_model.type[x];
+            entry.ist = state->current_model.ist[x];
+            entry.present = state->current_model.present[x];
+            entry.status = OUTPUT_STATUS_CHANGED;
+            entry.symbol = cfg->resolve == 1 ? name : NULL;
+            entry.timestamp = (int64_t)time(NULL);
+            output_entry(&entry);
+        }
+    }
+    output_flush();
+}
+
+static void
+report_timing(struct config *cfg, struct watch_state *state)
+{
+    if (state->report_scans == 0)
+    {
+        return;
+    }
+    INFO_MSG(cfg, "[WATCH] %llu scans, last %llu: avg %.3f us, min %.3f us, max %.3f us",
+                  (unsigned long long)state->scans,
+                  (unsigned long long)state->report_scans,
+                  state->report_ns / 1000.0 / state->report_scans,
+                  state->min_ns / 1000.0,
+                  state->max_ns / 1000.0);
+    state->report_scans = 0;
+    state->report_ns = 0;
+    state->min_ns = UINT64_MAX;
+    state->max_ns = 0;
+}
+
+/*
+ * continuously rescan the IDT until interrupted
+ * all setup (kernel type, memory source, symbols) was done once by the caller
+ * each scan is one bulk read and a diff_idt_tables() call, nothing is allocated in the loop
+ * the baseline is the archive if one was given, else the first scan
+ * returns 1 if the table changed or handlers left kernel text during the session, -1 on error
+ */
+int
+watch_idt(struct config *cfg)
+{
+    struct watch_state *state = calloc(1, sizeof(struct watch_state));
+    if (state == NULL)
+    {
+        ERROR_MSG("Can't allocate memory to watch the IDT.");
+        return -1;
+    }
+    state->min_ns = UINT64_MAX;
+    
+    if (cfg->in_filename[0] != '\0')
+    {
+        struct idt_archive archive = {0};
+        if (open_idt_archive(cfg->in_filename, &archive) != 0)
+        {
+            free(state);
+            return -1;
+        }
+        memcpy(state->baseline.descriptors, archive.descriptors, archive.nr_entries * sizeof(struct descriptor_idt));
+        state->baseline.nr_entries = archive.nr_entries;
+        if (cfg->ignore_slide == 1 && archive.legacy == 1)
+        {
+            ERROR_MSG("Archive has no KASLR slide, comparing the raw addresses.");
+        }
+        else if (cfg->ignore_slide == 1)
+        {
+            /* a baseline from another boot, move its handlers to our slide as compare does */
+            rebase_idt_descriptors(state->baseline.descriptors, state->baseline.nr_entries, archive.kernel_type, archive.kaslr_slide, cfg->kaslr_slide);
+        }
+        close_idt_archive(&archive);
+    }
+    else if (read_idt_snapshot(cfg, &state->baseline) != KERN_SUCCESS)
+    {
+        free(state);
+        return -1;
+    }
+    state->last = state->baseline;
+    if (cfg->history == 1)
+    {
+        if (history_open(&state->history, cfg->history_filename, cfg, 1) != 0)
+        {
+            free(state);
+            return -1;
+        }
+        state->recording = 1;
+    }
+    
+    signal(SIGINT, stop_handler);
+    signal(SIGTERM, stop_handler);
+    
+    uint64_t interval_ns = (uint64_t)(cfg->watch_interval * 1000000000.0);
+    uint64_t next_scan = monotonic_ns();
+    uint64_t next_report = next_scan + WATCH_REPORT_INTERVAL * 1000000000ULL;
+    INFO_MSG(cfg, "[INFO] Watching IDT every %.3f seconds, ctrl-c to stop.", cfg->watch_interval);
+    
+    while (g_stop == 0)
+    {
+        uint64_t start = monotonic_ns();
+        if (read_idt_snapshot(cfg, &state->current) != KERN_SUCCESS)
+        {
+            ERROR_MSG("Scan %llu failed to read the IDT.", (unsigned long long)state->scans);
+        }
+        else
+        {
+            int changed = diff_idt_tables(state->last.descriptors, state->current.descriptors, state->current.nr_entries, cfg->diff_fields, &state->diff) != 0;
+            if (changed)
+            {
+                report_changes(cfg, state);
+                state->last = state->current;
+                state->detected = 1;
+            }
+            /* a trampoline patches the handler code, the table itself doesn't change */
+            if (cfg->trampolines == 1)
+            {
+                decode_idt(state->current.descriptors, state->current.nr_entries, cfg->kernel_type, &state->current_model);
+                trace_idt_handlers(cfg, &state->current_model, &state->traces);
+                if (memcmp(state->traces.outside, state->last_outside, sizeof(state->last_outside)) != 0)
+                {
+                    ERROR_MSG("Scan %llu: %u handler(s) leave kernel text.", (unsigned long long)state->scans, state->traces.nr_outside);
+                    report_idt_traces(cfg, &state->current_model, &state->traces);
+                    memcpy(state->last_outside, state->traces.outside, sizeof(state->last_outside));
+                    state->detected |= state->traces.nr_outside > 0;
+                }
+            }
+            /* the first scan marks where this session starts, then only the changes */
+            if (state->recording == 1 && (changed || state->scans == 0) &&
+                history_append(&state->history, &state->current, (int64_t)time(NULL)) != 0)
+            {
+                ERROR_MSG("Stopped recording the history.");
+                state->recording = 0;
+            }
+        }
+        uint64_t elapsed = monotonic_ns() - start;
+        
+        state->scans++;
+        state->total_ns += elapsed;
+        state->report_scans++;
+        state->report_ns += elapsed;
+        if (elapsed < state->min_ns)
+        {
+            state->min_ns = elapsed;
+        }
+        if (elapsed > state->max_ns)
+        {
+            state->max_ns = elapsed;
+        }
+        if (start >= next_report)
+        {
+            report_timing(cfg, state);
+            next_report = start + WATCH_REPORT_INTERVAL * 1000000000ULL;
+        }
+        
+        /* don't try to catch up if a scan took longer than the interval */
+        next_scan += interval_ns;
+        if (next_scan < start)
+        {
+            next_scan = start;
+        }
+        sleep_until(next_scan);
+    }
+    
+    report_timing(cfg, state);
+    if (cfg->history == 1)
+    {
+        history_close(&state->history);
+    }
+    if (state->scans > 0)
+    {
+        INFO_MSG(cfg, "[INFO] Stopped after %llu scans, average scan %.3f us.",
+                      (unsigned long long)state->scans, state->total_ns / 1000.0 / state->scans);
+    }
+    int detected = state->detected;
+    free(state);
+    return detected;
+}